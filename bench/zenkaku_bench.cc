@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <zenkaku/debug.hpp>
+#include <zenkaku/zenkaku.hpp>
+
+// visitConverter(), to time static against virtual dispatch
+#include "converters.hpp"
+
+// Include the CLI11 single-header file
+#include <CLI/CLI.hpp>
+
+using namespace zenkaku;
+
+// --- Allocation Counting ---
+// Every allocation in the process goes through these, so a timed loop can
+// report how many heap allocations one conversion call makes. A library
+// built with ZENKAKU_COUNT_ALLOCATIONS already replaces them and counts per
+// thread, which is the same thing here since the loop runs on one thread.
+#ifdef ZENKAKU_COUNT_ALLOCATIONS
+namespace {
+size_t allocationsSoFar() { return threadAllocationCount(); }
+} // namespace
+#else
+namespace {
+std::atomic<size_t> allocationCount{0};
+
+size_t allocationsSoFar() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+} // namespace
+
+void *operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+#endif
+
+namespace {
+
+// --- Input Generation ---
+// Deterministic ASCII text: lowercase words and spaces, with `density` of
+// all characters being digits and a newline every `lineLength` characters
+// (none if 0). The same parameters always give the same bytes.
+std::string makeInput(size_t size, double density, size_t lineLength) {
+  uint64_t state = 0x9E3779B97F4A7C15ull ^ size;
+  auto next = [&state] {
+    // splitmix64
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  };
+  const auto digitThreshold =
+      static_cast<uint64_t>(density * static_cast<double>(UINT64_MAX));
+
+  std::string text(size, ' ');
+  for (size_t i = 0; i < size; ++i) {
+    if (lineLength > 0 && i % lineLength == lineLength - 1) {
+      text[i] = '\n';
+      continue;
+    }
+    uint64_t r = next();
+    if (density >= 1.0 || r < digitThreshold) {
+      text[i] = static_cast<char>('0' + (r >> 32) % 10);
+    } else if ((r >> 32) % 6 != 0) {
+      text[i] = static_cast<char>('a' + (r >> 40) % 26);
+    }
+  }
+  return text;
+}
+
+// --- Measurement ---
+struct Case {
+  std::string converter;
+  bool reverse;
+  size_t size; // ASCII bytes before any conversion
+  double density;
+  size_t lineLength;
+};
+
+struct Result {
+  Case spec;
+  size_t inputBytes;
+  size_t iterations;
+  double seconds;
+  size_t allocations;
+
+  double megabytesPerSecond() const {
+    return static_cast<double>(inputBytes) * static_cast<double>(iterations) /
+           seconds / 1e6;
+  }
+  double nanosecondsPerByte() const {
+    return seconds * 1e9 /
+           (static_cast<double>(inputBytes) * static_cast<double>(iterations));
+  }
+  double allocationsPerCall() const {
+    return static_cast<double>(allocations) / static_cast<double>(iterations);
+  }
+};
+
+// Runs one direction of `converter` over `input` into a reused output
+// string until at least `minSeconds` have passed. One untimed call first
+// sizes the output, as a long-running caller's buffer would be.
+Result measure(const Case &spec, const DigitConverter &converter,
+               std::string_view input, std::string &out, double minSeconds) {
+  using Clock = std::chrono::steady_clock;
+  out.clear();
+  convertText(converter, spec.reverse, input, out);
+
+  // Doubling batches keep clock reads out of the timing of tiny inputs
+  size_t iterations = 0;
+  size_t allocations = allocationsSoFar();
+  Clock::time_point start = Clock::now();
+  std::chrono::duration<double> elapsed{};
+  for (size_t batch = 1; elapsed.count() < minSeconds; batch *= 2) {
+    for (size_t i = 0; i < batch; ++i) {
+      out.clear();
+      convertText(converter, spec.reverse, input, out);
+    }
+    iterations += batch;
+    elapsed = Clock::now() - start;
+  }
+  allocations = allocationsSoFar() - allocations;
+
+  return {spec, input.size(), iterations, elapsed.count(), allocations};
+}
+
+// --- Cold Start ---
+// Wall time of whole `zenkaku -t fullwidth 0` processes, stdout discarded:
+// exec, dynamic loading, static initialisation, argument parsing and one
+// tiny conversion. This is what a caller converting one string per process
+// pays every time.
+struct Startup {
+  std::string cli;
+  size_t runs;
+  double medianMicros;
+  double minMicros;
+};
+
+std::optional<Startup> measureStartup(const std::string &cli,
+                                      double minSeconds) {
+  using Clock = std::chrono::steady_clock;
+  static constexpr size_t kMinRuns = 20;
+
+  posix_spawn_file_actions_t actions;
+  ::posix_spawn_file_actions_init(&actions);
+  ::posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+  std::string args[] = {cli, "-t", "fullwidth", "0"};
+  char *argv[] = {args[0].data(), args[1].data(), args[2].data(),
+                  args[3].data(), nullptr};
+
+  std::vector<double> samples;
+  Clock::time_point begin = Clock::now();
+  bool ok = true;
+  while (ok && (samples.size() < kMinRuns ||
+                std::chrono::duration<double>(Clock::now() - begin).count() <
+                    minSeconds)) {
+    Clock::time_point start = Clock::now();
+    pid_t pid;
+    int status = 0;
+    ok = ::posix_spawn(&pid, cli.c_str(), &actions, nullptr, argv,
+                       environ) == 0 &&
+         ::waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  ::posix_spawn_file_actions_destroy(&actions);
+  if (!ok)
+    return std::nullopt;
+
+  std::sort(samples.begin(), samples.end());
+  return Startup{cli, samples.size(), samples[samples.size() / 2],
+                 samples.front()};
+}
+
+// --- Dispatch Overhead ---
+// Converts a text one line at a time, as a line-buffered stream or a request
+// loop calls the library: once through the virtual DigitConverter interface
+// and once inside visitConverter(), where the converter's type is resolved
+// before the loop. The difference is the per-call cost of virtual dispatch.
+struct Dispatch {
+  std::string converter;
+  bool reverse;
+  size_t lineLength;
+  size_t lines;
+  double virtualNanos; // per line
+  double staticNanos;
+};
+
+// Defeats dead-code elimination of the timed loops
+volatile size_t dispatchSink;
+
+template <typename Convert>
+double nanosPerLine(const std::vector<std::string_view> &lines,
+                    std::span<char> dst, double minSeconds,
+                    const Convert &convert) {
+  using Clock = std::chrono::steady_clock;
+  size_t passes = 0;
+  size_t total = 0;
+  Clock::time_point start = Clock::now();
+  std::chrono::duration<double, std::nano> elapsed{};
+  for (size_t batch = 1; elapsed.count() < minSeconds * 1e9; batch *= 2) {
+    for (size_t i = 0; i < batch; ++i) {
+      for (std::string_view line : lines) {
+        total += convert(line, dst);
+      }
+    }
+    passes += batch;
+    elapsed = Clock::now() - start;
+  }
+  dispatchSink = total;
+  return elapsed.count() / static_cast<double>(passes * lines.size());
+}
+
+Dispatch measureDispatch(std::string_view name,
+                         const DigitConverter &converter, bool reverse,
+                         size_t lineLength, std::string_view text,
+                         double minSeconds) {
+  std::vector<std::string_view> lines;
+  while (!text.empty()) {
+    size_t end = std::min(text.find('\n'), text.size() - 1) + 1;
+    lines.push_back(text.substr(0, end));
+    text.remove_prefix(end);
+  }
+  std::vector<char> dst(maxOutputSize(4 * lineLength, reverse));
+
+  double virtualNanos = nanosPerLine(
+      lines, dst, minSeconds, [&](std::string_view line, std::span<char> out) {
+        return convertTextTo(converter, reverse, line, out);
+      });
+  double staticNanos =
+      visitConverter(converter, reverse, [&](const auto &convert) {
+        return nanosPerLine(lines, dst, minSeconds, convert);
+      });
+  return {std::string(name), reverse,     lineLength,
+          lines.size(),      virtualNanos, staticNanos};
+}
+
+std::string formatSize(size_t bytes) {
+  static constexpr const char *kUnits[] = {"B", "KiB", "MiB", "GiB"};
+  size_t unit = 0;
+  while (unit + 1 < std::size(kUnits) && bytes >= 1024 && bytes % 1024 == 0) {
+    bytes /= 1024;
+    ++unit;
+  }
+  return std::to_string(bytes) + kUnits[unit];
+}
+
+std::string formatLine(size_t lineLength) {
+  return lineLength == 0 ? "none" : std::to_string(lineLength);
+}
+
+// --- Reporting ---
+void printTable(const std::vector<Result> &results, std::ostream &os) {
+  char row[160];
+  std::snprintf(row, sizeof(row), "%-10s %-8s %8s %8s %6s %10s %10s %9s %8s",
+                "converter", "dir", "size", "density", "line", "iters",
+                "MB/s", "ns/byte", "allocs");
+  os << row << '\n';
+  for (const Result &r : results) {
+    std::snprintf(row, sizeof(row),
+                  "%-10s %-8s %8s %7g%% %6s %10zu %10.1f %9.3f %8.2f",
+                  r.spec.converter.c_str(),
+                  r.spec.reverse ? "reverse" : "convert",
+                  formatSize(r.spec.size).c_str(), r.spec.density * 100,
+                  formatLine(r.spec.lineLength).c_str(), r.iterations,
+                  r.megabytesPerSecond(), r.nanosecondsPerByte(),
+                  r.allocationsPerCall());
+    os << row << '\n';
+  }
+}
+
+void printDispatch(const std::vector<Dispatch> &results, std::ostream &os) {
+  char row[160];
+  std::snprintf(row, sizeof(row), "%-10s %-8s %6s %12s %12s %8s", "converter",
+                "dir", "line", "virtual ns", "static ns", "speedup");
+  os << row << '\n';
+  for (const Dispatch &r : results) {
+    std::snprintf(row, sizeof(row), "%-10s %-8s %6zu %12.2f %12.2f %7.2fx",
+                  r.converter.c_str(), r.reverse ? "reverse" : "convert",
+                  r.lineLength, r.virtualNanos, r.staticNanos,
+                  r.virtualNanos / r.staticNanos);
+    os << row << '\n';
+  }
+}
+
+void printStartup(const Startup &startup, std::ostream &os) {
+  char row[160];
+  std::snprintf(row, sizeof(row),
+                "startup: median %.0f us, min %.0f us over %zu runs",
+                startup.medianMicros, startup.minMicros, startup.runs);
+  os << row << '\n';
+}
+
+// One result per line, in a fixed key order, so two runs diff cleanly.
+void printJson(const std::vector<Result> &results,
+               const std::optional<Startup> &startup,
+               const std::vector<Dispatch> &dispatch, std::ostream &os) {
+  char row[512];
+  os << "{\"kernel\": \"" << kernelName(activeKernel()) << "\",\n";
+  if (startup) {
+    std::snprintf(row, sizeof(row),
+                  "\"startup\": {\"runs\": %zu, \"median_us\": %.1f, "
+                  "\"min_us\": %.1f},",
+                  startup->runs, startup->medianMicros, startup->minMicros);
+    os << row << '\n';
+  }
+  if (!dispatch.empty()) {
+    os << "\"dispatch\": [\n";
+    for (size_t i = 0; i < dispatch.size(); ++i) {
+      const Dispatch &r = dispatch[i];
+      std::snprintf(row, sizeof(row),
+                    "  {\"converter\": \"%s\", \"direction\": \"%s\", "
+                    "\"line_length\": %zu, \"lines\": %zu, "
+                    "\"virtual_ns_per_line\": %.2f, "
+                    "\"static_ns_per_line\": %.2f}%s",
+                    r.converter.c_str(), r.reverse ? "reverse" : "convert",
+                    r.lineLength, r.lines, r.virtualNanos, r.staticNanos,
+                    i + 1 < dispatch.size() ? "," : "");
+      os << row << '\n';
+    }
+    os << "],\n";
+  }
+  os << "\"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    std::snprintf(
+        row, sizeof(row),
+        "  {\"converter\": \"%s\", \"direction\": \"%s\", \"size\": %zu, "
+        "\"density\": %g, \"line_length\": %zu, \"input_bytes\": %zu, "
+        "\"iterations\": %zu, \"mb_per_s\": %.1f, \"ns_per_byte\": %.4f, "
+        "\"allocs_per_call\": %.2f}%s",
+        r.spec.converter.c_str(), r.spec.reverse ? "reverse" : "convert",
+        r.spec.size, r.spec.density, r.spec.lineLength, r.inputBytes,
+        r.iterations, r.megabytesPerSecond(), r.nanosecondsPerByte(),
+        r.allocationsPerCall(), i + 1 < results.size() ? "," : "");
+    os << row << '\n';
+  }
+  os << "]}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  CLI::App app{"Benchmark convert and reverse for every registered converter."};
+
+  size_t max_size = size_t{1} << 30;
+  app.add_option("--max-size", max_size,
+                 "Largest input in the size sweep (64B .. 1GiB, x64 steps). "
+                 "Accepts K/M/G suffixes; below 64 skips the sweep.")
+      ->transform(CLI::AsSizeValue(false));
+
+  double min_time = 0.2;
+  app.add_option("--min-time", min_time,
+                 "Minimum seconds to spend timing each case.");
+
+  std::vector<std::string> kernel_names;
+  for (Kernel kernel : kKernels) {
+    kernel_names.emplace_back(kernelName(kernel));
+  }
+  std::string kernel_name;
+  app.add_option("--kernel", kernel_name,
+                 "Kernel to benchmark instead of the best one this CPU "
+                 "supports.")
+      ->check(CLI::IsMember(kernel_names));
+
+  bool startup_option = false;
+  app.add_flag("--startup", startup_option,
+               "Also time whole runs of the zenkaku binary converting one "
+               "short argument.");
+
+#ifdef ZENKAKU_CLI_PATH
+  std::string cli_path = ZENKAKU_CLI_PATH;
+#else
+  std::string cli_path = "zenkaku";
+#endif
+  app.add_option("--cli", cli_path,
+                 "zenkaku binary for --startup. Defaults to the one built "
+                 "alongside this benchmark.");
+
+  bool dispatch_option = false;
+  app.add_flag("--dispatch", dispatch_option,
+               "Also time line-at-a-time conversion through virtual calls "
+               "against a converter resolved once.");
+
+  std::string json_path;
+  app.add_option("--json", json_path,
+                 "Also write results as JSON to FILE ('-' for stdout).");
+
+  CLI11_PARSE(app, argc, argv);
+
+  if (!kernel_name.empty() && !selectKernel(*parseKernel(kernel_name))) {
+    std::cerr << "Error: Kernel '" << kernel_name
+              << "' is not supported on this CPU" << std::endl;
+    return 1;
+  }
+  std::cerr << "kernel: " << kernelName(activeKernel()) << std::endl;
+
+  std::optional<Startup> startup;
+  if (startup_option) {
+    startup = measureStartup(cli_path, min_time);
+    if (!startup) {
+      std::cerr << "Error: cannot run '" << cli_path << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<Dispatch> dispatch;
+  if (dispatch_option) {
+    static constexpr size_t kDispatchLines[] = {16, 80};
+    std::string forward;
+    for (size_t lineLength : kDispatchLines) {
+      std::string ascii = makeInput(64 << 10, 0.1, lineLength);
+      for (const ConverterRegistry::Entry &entry :
+           defaultRegistry().getEntries()) {
+        const DigitConverter &converter = *entry.converter;
+        forward.clear();
+        converter.convert(ascii, forward);
+        dispatch.push_back(measureDispatch(entry.name, converter, false,
+                                           lineLength, ascii, min_time));
+        dispatch.push_back(measureDispatch(entry.name, converter, true,
+                                           lineLength, forward, min_time));
+        std::cerr << '.' << std::flush;
+      }
+    }
+    std::cerr << '\n';
+  }
+
+  // Size x density sweep at a typical line length, then a line-length sweep
+  // at one mid-sized input.
+  static constexpr double kDensities[] = {0.0, 0.01, 0.1, 1.0};
+  static constexpr size_t kLineLength = 80;
+  static constexpr size_t kLineLengths[] = {16, 80, 4096, 0};
+  std::vector<Case> inputs;
+  for (size_t size = 64; size <= max_size; size *= 64) {
+    for (double density : kDensities) {
+      inputs.push_back({"", false, size, density, kLineLength});
+    }
+  }
+  size_t lineSweepSize = std::min<size_t>(16 << 20, max_size);
+  for (size_t lineLength : kLineLengths) {
+    if (lineLength != kLineLength && lineSweepSize >= 64)
+      inputs.push_back({"", false, lineSweepSize, 0.1, lineLength});
+  }
+
+  std::vector<Result> results;
+  std::string forward, backward;
+  for (const Case &input : inputs) {
+    std::string ascii =
+        makeInput(input.size, input.density, input.lineLength);
+    for (const ConverterRegistry::Entry &entry :
+         defaultRegistry().getEntries()) {
+      const DigitConverter &converter = *entry.converter;
+      Case spec = input;
+      spec.converter = entry.name;
+      results.push_back(measure(spec, converter, ascii, forward, min_time));
+      // The forward output is the reverse input
+      spec.reverse = true;
+      results.push_back(measure(spec, converter, forward, backward, min_time));
+      std::cerr << '.' << std::flush;
+    }
+  }
+  std::cerr << '\n';
+
+  printTable(results, std::cout);
+  if (!dispatch.empty())
+    printDispatch(dispatch, std::cout);
+  if (startup)
+    printStartup(*startup, std::cout);
+  if (json_path == "-") {
+    printJson(results, startup, dispatch, std::cout);
+  } else if (!json_path.empty()) {
+    std::ofstream json(json_path);
+    printJson(results, startup, dispatch, json);
+    if (!json) {
+      std::cerr << "Error: cannot write '" << json_path << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+namespace zenkaku {
+
+// --- Allocation Accounting ---
+// Built with -DZENKAKU_COUNT_ALLOCATIONS=ON, the library replaces the global
+// operator new with one that counts allocations per thread, and the stream
+// engines check that their steady-state loops make none. Without the option
+// NoAllocationScope compiles to nothing.
+#ifdef ZENKAKU_COUNT_ALLOCATIONS
+// Heap allocations made so far by the calling thread.
+size_t threadAllocationCount();
+
+// Reports the allocation and aborts.
+[[noreturn]] void unexpectedAllocation(const char *where);
+#endif
+
+// Aborts if the calling thread allocates between construction and
+// destruction of the scope.
+class NoAllocationScope {
+public:
+#ifdef ZENKAKU_COUNT_ALLOCATIONS
+  explicit NoAllocationScope(const char *where)
+      : where(where), start(threadAllocationCount()) {}
+  ~NoAllocationScope() {
+    if (threadAllocationCount() != start)
+      unexpectedAllocation(where);
+  }
+
+private:
+  const char *where;
+  size_t start;
+#else
+  explicit NoAllocationScope(const char *) {}
+#endif
+};
+
+} // namespace zenkaku
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace zenkaku {
+
+// --- Daemon Protocol ---
+// Every message is a fixed header followed by its body; integers are
+// big-endian.
+//
+//   request:  u8 direction, u8 type length, u32 payload length,
+//             type name, payload
+//   response: u8 status, u32 body length, body
+//
+// The body of an Ok response is the converted payload; for any other status
+// it is an error message. A client may pipeline any number of requests on
+// one connection; responses come back in request order.
+enum class RequestDirection : uint8_t { Forward = 0, Reverse = 1 };
+
+enum class ResponseStatus : uint8_t {
+  Ok = 0,
+  UnknownType = 1,
+  BadRequest = 2,
+};
+
+inline constexpr size_t kRequestHeaderSize = 6;
+inline constexpr size_t kResponseHeaderSize = 5;
+// Largest payload the server accepts in one request
+inline constexpr size_t kMaxRequestPayload = 16 << 20;
+
+// --- Conversion Server ---
+// Keeps converters resident and answers framed requests over a Unix domain
+// socket, so callers converting many short strings pay process startup
+// once. All connections are served by one thread from an epoll(7) loop with
+// non-blocking sockets; conversions are short enough that a worker hand-off
+// would cost more than it saves.
+class ConversionServer {
+public:
+  ConversionServer() = default;
+  ConversionServer(const ConversionServer &) = delete;
+  ConversionServer &operator=(const ConversionServer &) = delete;
+  ~ConversionServer();
+
+  // Binds and listens on `path`, replacing a socket file no live server
+  // accepts on. Returns false with errno set on failure: EEXIST if `path`
+  // is not a socket, EADDRINUSE if another server is listening there.
+  bool listen(const std::string &path);
+
+  // Serves clients until stop() is called. Returns false with errno set if
+  // the event loop fails.
+  bool run();
+
+  // Makes run() return. Async-signal-safe, so it can be called from a
+  // SIGINT/SIGTERM handler.
+  static void stop();
+
+private:
+  struct Connection {
+    std::string input;
+    std::string output;
+    size_t written = 0;
+    bool closing = false;
+  };
+
+  void accept();
+  // Handles readiness on `fd`; returns false once the connection is done.
+  bool service(int fd, Connection &connection, uint32_t events);
+  void dispatch(Connection &connection);
+  bool flush(int fd, Connection &connection);
+  void watch(int fd, const Connection &connection);
+  void close(int fd);
+
+  int listenFd = -1;
+  int epollFd = -1;
+  // This server's wake-up eventfd; stop() writes to the last one created
+  int eventFd = -1;
+  std::string socketPath;
+  std::unordered_map<int, Connection> connections;
+};
+
+// --- Conversion Client ---
+// Minimal blocking client for ConversionServer, used by `zenkaku --connect`
+// and for testing the daemon.
+class ConversionClient {
+public:
+  struct Response {
+    ResponseStatus status = ResponseStatus::Ok;
+    std::string body;
+  };
+
+  ConversionClient() = default;
+  ConversionClient(const ConversionClient &) = delete;
+  ConversionClient &operator=(const ConversionClient &) = delete;
+  ~ConversionClient();
+
+  // Connects to the server at `path`. Returns false with errno set on
+  // failure.
+  bool connect(const std::string &path);
+
+  // Sends one request and waits for its response. Returns false with errno
+  // set on I/O failure or if the server closes the connection.
+  bool request(std::string_view type, RequestDirection direction,
+               std::string_view payload, Response &response);
+
+private:
+  int fd = -1;
+};
+
+} // namespace zenkaku
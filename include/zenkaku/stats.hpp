@@ -0,0 +1,72 @@
+#pragma once
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace zenkaku {
+
+// --- Conversion Statistics ---
+// Running totals kept by the conversion engines and the daemon. Recording is
+// off until enableStats() is called. Each thread counts into its own
+// cache-line-aligned block, so recording one block of input costs a few
+// uncontended atomic adds, two clock reads per phase and a newline scan.
+// collectStats() sums every thread's block, including threads that have
+// exited, and may run concurrently with recording.
+enum class Phase { Read, Convert, Write };
+
+struct Stats {
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  uint64_t lines = 0;
+  // Digits converted in either direction
+  uint64_t sequences = 0;
+  // Summed over threads, so Convert can exceed wall time with --jobs
+  std::chrono::nanoseconds readTime{};
+  std::chrono::nanoseconds convertTime{};
+  std::chrono::nanoseconds writeTime{};
+  // Sequences per converter name, in first-seen order
+  std::vector<std::pair<std::string, uint64_t>> sequencesByConverter;
+};
+
+void enableStats(bool enabled = true);
+bool statsEnabled();
+
+// Counts `input`, converted by `converter` into `outputSize` bytes, on the
+// calling thread. Unchanged passthrough runs are recorded the same way with
+// outputSize == input.size(). Every registered script is a table of 3-byte
+// sequences, so the sequence count follows from the size difference.
+void recordConversion(const DigitConverter &converter, bool reverse,
+                      std::string_view input, size_t outputSize);
+
+// Adds `elapsed` to the calling thread's time in `phase`.
+void recordTime(Phase phase, std::chrono::nanoseconds elapsed);
+
+Stats collectStats();
+
+// Times its own lifetime into `phase`. Reads no clock while stats are off.
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Phase phase) : phase(phase), enabled(statsEnabled()) {
+    if (enabled)
+      start = std::chrono::steady_clock::now();
+  }
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+  ~PhaseTimer() {
+    if (enabled)
+      recordTime(phase, std::chrono::steady_clock::now() - start);
+  }
+
+private:
+  Phase phase;
+  bool enabled;
+  std::chrono::steady_clock::time_point start;
+};
+
+} // namespace zenkaku
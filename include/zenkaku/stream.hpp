@@ -0,0 +1,346 @@
+#pragma once
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <array>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace zenkaku {
+
+// --- Stream Processing ---
+// Writes all of `data` to `fd`, retrying short writes and EINTR.
+bool writeAll(int fd, std::string_view data);
+
+// Writes every buffer in `iov` to `fd`, resuming after short writes. The
+// iovec entries are consumed as they are written.
+bool writeAllv(int fd, iovec *iov, size_t count);
+
+// Returns the length of the incomplete UTF-8 sequence at the end of `data`,
+// or 0 if the data ends on a character boundary.
+size_t incompleteUtf8Tail(std::string_view data);
+
+// Reusable output buffer. Capacity grows geometrically and is never given
+// back, so a buffer reused block after block stops allocating once it has
+// held the largest block. New storage is not zeroed, and contents are not
+// kept across growth.
+class ScratchBuffer {
+public:
+  ScratchBuffer() = default;
+  explicit ScratchBuffer(size_t size) { reserve(size); }
+
+  // Returns the whole buffer, grown to at least `size` bytes if needed.
+  std::span<char> reserve(size_t size) {
+    if (size > capacity)
+      grow(size);
+    return {storage.get(), capacity};
+  }
+
+  const char *data() const { return storage.get(); }
+
+private:
+  void grow(size_t size);
+
+  std::unique_ptr<char[]> storage;
+  size_t capacity = 0;
+};
+
+// Converts a byte stream block by block. Input is read with read(2) into a
+// fixed-size buffer, so memory stays bounded by the block size no matter how
+// long a line is. A multi-byte UTF-8 sequence split across two reads is
+// carried over to the next block, so reverse() always sees it whole. Output
+// is byte-exact: nothing is added or dropped between blocks. Both buffers
+// are sized for the largest block up front, so run() never allocates. The
+// converter's type and the direction are resolved once per run, so the
+// block loop makes no virtual calls.
+class StreamConverter {
+public:
+  static constexpr size_t kBlockSize = 1 << 20;
+
+  StreamConverter(const DigitConverter &converter, bool reverse)
+      : converter(converter), reverseMode(reverse), buffer(kBlockSize + 4),
+        out(maxOutputSize(kBlockSize + 4, reverse)) {}
+
+  // Streams `inFd` to `outFd` until end of input. Returns false with errno
+  // set if a read or write fails.
+  bool run(int inFd, int outFd);
+
+private:
+  template <typename Directed>
+  bool runWith(const Directed &convert, int inFd, int outFd);
+  template <typename Directed>
+  bool flush(const Directed &convert, std::string_view block, int outFd);
+
+  const DigitConverter &converter;
+  bool reverseMode;
+  std::vector<char> buffer;
+  ScratchBuffer out;
+};
+
+// --- Pipelined Conversion ---
+// Bounded single-producer/single-consumer queue. Each side writes only its
+// own index, so push() and pop() are a load, a store and a notify, and block
+// with atomic wait (a futex on Linux) only when the ring is full or empty.
+template <typename T, size_t Capacity> class SpscRing {
+public:
+  void push(T value) {
+    size_t back = tail.load(std::memory_order_relaxed);
+    size_t front;
+    while (back - (front = head.load(std::memory_order_acquire)) == Capacity) {
+      head.wait(front, std::memory_order_acquire);
+    }
+    slots[back % Capacity] = std::move(value);
+    tail.store(back + 1, std::memory_order_release);
+    tail.notify_one();
+  }
+
+  T pop() {
+    size_t front = head.load(std::memory_order_relaxed);
+    size_t back;
+    while ((back = tail.load(std::memory_order_acquire)) == front) {
+      tail.wait(back, std::memory_order_acquire);
+    }
+    T value = std::move(slots[front % Capacity]);
+    head.store(front + 1, std::memory_order_release);
+    head.notify_one();
+    return value;
+  }
+
+private:
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+  std::array<T, Capacity> slots{};
+};
+
+// Converts a byte stream on three threads joined by SpscRings: a reader, a
+// converter, and the calling thread as writer. kDepth fixed blocks circle
+// from reader to converter to writer and back, so reading the next block,
+// converting the current one and writing the previous one overlap, and in a
+// `zstdcat | zenkaku | split` chain neither pipe waits on conversion. Blocks
+// follow StreamConverter's rules: one read(2) of up to kBlockSize bytes,
+// with a split UTF-8 sequence carried over to the next block.
+class PipelineConverter {
+public:
+  static constexpr size_t kBlockSize = StreamConverter::kBlockSize;
+  static constexpr size_t kDepth = 4;
+
+  PipelineConverter(const DigitConverter &converter, bool reverse);
+
+  // Streams `inFd` to `outFd` until end of input. Returns false with errno
+  // set if a read or write fails.
+  bool run(int inFd, int outFd);
+
+private:
+  struct Block {
+    std::vector<char> input;
+    size_t size = 0;
+    ScratchBuffer output;
+    size_t outputSize = 0;
+    // End of input, or a failed read or cancelled run with size 0
+    bool last = false;
+  };
+
+  void read(int inFd);
+  void convert();
+
+  const DigitConverter &converter;
+  bool reverseMode;
+  std::array<Block, kDepth> blocks;
+  SpscRing<Block *, kDepth> idle;
+  SpscRing<Block *, kDepth> filled;
+  SpscRing<Block *, kDepth> converted;
+  // Set by the writer after a failed write, so the reader stops early
+  std::atomic<bool> cancelled{false};
+  int readErrno = 0;
+};
+
+// --- Parallel Conversion ---
+// Fixed set of worker threads draining a FIFO of tasks. The destructor runs
+// every queued task before joining. Tasks that fit std::function's inline
+// storage (two pointers) and a queue that has already held the deepest
+// backlog make submit() allocation-free.
+class WorkerPool {
+public:
+  explicit WorkerPool(size_t threadCount);
+  ~WorkerPool();
+
+  void submit(std::function<void()> task);
+
+  // Runs task(0) .. task(count - 1) on the pool and waits for all of them.
+  void forEach(size_t count, const std::function<void(size_t)> &task);
+
+private:
+  // Ring buffer over a vector that doubles when full.
+  class TaskQueue {
+  public:
+    explicit TaskQueue(size_t capacity) : slots(capacity) {}
+
+    bool empty() const { return count == 0; }
+    void push(std::function<void()> task);
+    std::function<void()> pop();
+
+  private:
+    std::vector<std::function<void()>> slots;
+    size_t head = 0;
+    size_t count = 0;
+  };
+
+  void work();
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  TaskQueue tasks;
+  bool stopping = false;
+  std::vector<std::thread> threads;
+};
+
+// Converts a byte stream on a WorkerPool. Input is cut into chunks of about
+// kChunkSize at newline boundaries (or at a UTF-8 boundary for a line longer
+// than a chunk). Up to two chunks per worker are in flight; the calling
+// thread reads input and writes each chunk's output once it and every
+// earlier chunk are done, so output order matches input order. Converters
+// are stateless and const, so one instance is shared by all workers. Chunk
+// buffers are sized once in the constructor and reused.
+class ParallelStreamConverter {
+public:
+  static constexpr size_t kChunkSize = 4 << 20;
+
+  ParallelStreamConverter(const DigitConverter &converter, bool reverse,
+                          size_t jobs)
+      : converter(converter), reverseMode(reverse), chunks(2 * jobs),
+        pool(jobs) {
+    carry.reserve(kChunkSize);
+    for (Chunk &chunk : chunks) {
+      chunk.input.reserve(kChunkSize);
+      chunk.output.reserve(maxOutputSize(kChunkSize, reverse));
+    }
+  }
+
+  // Streams `inFd` to `outFd` until end of input. Returns false with errno
+  // set if a read or write fails.
+  bool run(int inFd, int outFd);
+
+private:
+  struct Chunk {
+    std::string input;
+    ScratchBuffer output;
+    size_t outputSize = 0;
+    bool pending = false;
+    bool done = false;
+  };
+
+  void wait(Chunk &chunk);
+  bool finish(Chunk &chunk, int outFd);
+  bool abandon();
+
+  const DigitConverter &converter;
+  bool reverseMode;
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::string carry;
+  std::vector<Chunk> chunks;
+  WorkerPool pool;
+};
+
+// --- Memory-Mapped Input ---
+// Read-only mapping of a whole regular file, advised for sequential access.
+// An empty file maps to an empty view.
+class MappedInput {
+public:
+  MappedInput() = default;
+  MappedInput(const MappedInput &) = delete;
+  MappedInput &operator=(const MappedInput &) = delete;
+  ~MappedInput();
+
+  // Maps all of `fd`. Returns false with errno set on failure.
+  bool map(int fd);
+
+  std::string_view view() const {
+    return {static_cast<const char *>(data), data ? size : 0};
+  }
+
+private:
+  void *data = nullptr;
+  size_t size = 0;
+};
+
+// --- Memory-Mapped File Conversion ---
+// Converts a mapped file without copying what stays the same. Unchanged
+// runs of at least kMinZeroCopy bytes are handed to writev(2) straight from
+// the mapping; only the regions in between are converted into a scratch
+// buffer. When digits are sparse, most output bytes never pass through a
+// user-space copy. The scan resolves the converter's type once, so its
+// per-change passthrough calls are direct.
+class MappedFileConverter {
+public:
+  static constexpr size_t kMinZeroCopy = 4096;
+  static constexpr size_t kMaxRegion = 256 << 10;
+  static constexpr size_t kScratchSize = 2 * 3 * (kMaxRegion + kMinZeroCopy);
+
+  MappedFileConverter(const DigitConverter &converter, bool reverse)
+      : converter(converter), reverseMode(reverse), scratch(kScratchSize) {
+    pending.reserve(IOV_MAX);
+  }
+
+  // Converts all of `inFd`, a regular file, into `outFd`. Returns false with
+  // errno set on failure.
+  bool run(int inFd, int outFd);
+
+private:
+  template <typename Directed>
+  bool runWith(const Directed &convert, std::string_view input, int outFd);
+  template <typename Directed>
+  bool convertRegion(const Directed &convert, std::string_view region,
+                     int outFd);
+  bool emit(const char *data, size_t size, int outFd);
+  bool flush(int outFd);
+
+  const DigitConverter &converter;
+  bool reverseMode;
+  ScratchBuffer scratch;
+  size_t used = 0;
+  std::vector<iovec> pending;
+};
+
+// --- Memory-Mapped Parallel Conversion ---
+// Converts a regular file into a regular file in two parallel passes. The
+// input is mapped and cut into newline-aligned chunks. Workers first compute
+// the exact output size of every chunk; a prefix sum over those sizes gives
+// each chunk its final offset. The output file is then sized once with
+// ftruncate(2), its blocks reserved with posix_fallocate(3) and mapped, and
+// every worker converts its chunk straight into place, so there is no
+// ordered reassembly and no intermediate buffer. On a file system that
+// cannot reserve blocks it falls back to ParallelStreamConverter.
+class MappedParallelConverter {
+public:
+  static constexpr size_t kMinChunkSize = 1 << 20;
+
+  MappedParallelConverter(const DigitConverter &converter, bool reverse,
+                          size_t jobs)
+      : converter(converter), reverseMode(reverse), jobs(jobs), pool(jobs) {}
+
+  // Converts all of `inFd` into `outFd`, both regular files. Returns false
+  // with errno set on failure.
+  bool run(int inFd, int outFd);
+
+private:
+  const DigitConverter &converter;
+  bool reverseMode;
+  size_t jobs;
+  WorkerPool pool;
+};
+
+} // namespace zenkaku
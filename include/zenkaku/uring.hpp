@@ -0,0 +1,92 @@
+#pragma once
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace zenkaku {
+
+// --- io_uring Conversion ---
+// Converts a stream with its reads and writes queued on an io_uring(7), so
+// storage keeps working while the calling thread converts. Input and output
+// buffers are registered with the ring once and addressed by index.
+//
+// A regular input file is read at explicit offsets with a read in flight on
+// every idle slot; a regular output file (not O_APPEND) is written the same
+// way, so up to kSlots operations overlap. Pipes, terminals and sockets have
+// no offsets, so on those one read and one write are in flight at a time,
+// in stream order. Blocks are converted in input order with a split UTF-8
+// sequence carried to the next block, exactly like StreamConverter, and both
+// file positions are left where blocking I/O would have left them.
+class UringConverter {
+public:
+  static constexpr size_t kBlockSize = 1 << 20;
+  static constexpr size_t kSlots = 8;
+
+  UringConverter(const DigitConverter &converter, bool reverse);
+  UringConverter(const UringConverter &) = delete;
+  UringConverter &operator=(const UringConverter &) = delete;
+  ~UringConverter();
+
+  // True if the kernel provides io_uring with plain and fixed-buffer reads
+  // and writes. Probed once; callers fall back to StreamConverter otherwise.
+  static bool supported();
+
+  // Converts `inFd` into `outFd` until end of input. Returns false with
+  // errno set if the ring cannot be set up or an operation fails.
+  bool run(int inFd, int outFd);
+
+private:
+  struct Ring;
+
+  struct Slot {
+    enum class State { Idle, Reading, Ready, Queued, Writing };
+    State state = State::Idle;
+    uint64_t sequence = 0;
+    // Input bytes read so far; a regular file may return a read short
+    size_t filled = 0;
+    bool eof = false;
+    uint64_t inOffset = 0;
+    size_t outSize = 0;
+    size_t written = 0;
+    uint64_t outOffset = 0;
+  };
+
+  char *input(size_t slot) const;
+  char *output(size_t slot) const;
+
+  void refill();
+  void convertReady();
+  void submitRead(size_t slot);
+  void submitWrite(size_t slot);
+  void complete(size_t slot, int result);
+  bool inFlight() const;
+
+  const DigitConverter &converter;
+  bool reverseMode;
+  std::unique_ptr<char[]> arena;
+  std::array<Slot, kSlots> slots;
+
+  // Per-run state
+  std::unique_ptr<Ring> ring;
+  bool fixedBuffers = false;
+  int inFd = -1;
+  int outFd = -1;
+  bool positionalInput = false;
+  bool positionalOutput = false;
+  uint64_t nextRead = 0;
+  uint64_t nextConvert = 0;
+  uint64_t inPosition = 0;
+  uint64_t outPosition = 0;
+  uint64_t consumed = 0;
+  bool readEnd = false;
+  bool inputDone = false;
+  char carried[4] = {};
+  size_t carry = 0;
+  int error = 0;
+};
+
+} // namespace zenkaku
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace zenkaku {
+
+// --- UTF-8 Codec ---
+// Everything zenkaku reads and writes is UTF-8 bytes, so it needs no C++
+// locale or wide-character facet. These constexpr helpers are the whole
+// codec: the script tables are encoded from code points at compile time,
+// and the stream engines find character boundaries with sequenceLength().
+
+// Length of the sequence that `lead` starts: 1 to 4, or 0 for a
+// continuation byte or a byte that never starts a sequence (0xC0, 0xC1,
+// 0xF5..0xFF).
+constexpr size_t sequenceLength(unsigned char lead) {
+  if (lead < 0x80)
+    return 1;
+  if (lead < 0xC2)
+    return 0;
+  if (lead < 0xE0)
+    return 2;
+  if (lead < 0xF0)
+    return 3;
+  return lead < 0xF5 ? 4 : 0;
+}
+
+// One encoded code point.
+struct Utf8Char {
+  std::array<char, 4> bytes{};
+  size_t size = 0;
+
+  constexpr std::string_view view() const { return {bytes.data(), size}; }
+};
+
+// Encodes `codePoint`. Surrogates and values past U+10FFFF encode to
+// nothing (size 0).
+constexpr Utf8Char encodeUtf8(char32_t codePoint) {
+  Utf8Char encoded;
+  auto byte = [](char32_t value) { return static_cast<char>(value); };
+  if (codePoint < 0x80) {
+    encoded.bytes = {byte(codePoint)};
+    encoded.size = 1;
+  } else if (codePoint < 0x800) {
+    encoded.bytes = {byte(0xC0 | (codePoint >> 6)),
+                     byte(0x80 | (codePoint & 0x3F))};
+    encoded.size = 2;
+  } else if (codePoint < 0x10000) {
+    if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+      return encoded;
+    encoded.bytes = {byte(0xE0 | (codePoint >> 12)),
+                     byte(0x80 | ((codePoint >> 6) & 0x3F)),
+                     byte(0x80 | (codePoint & 0x3F))};
+    encoded.size = 3;
+  } else if (codePoint < 0x110000) {
+    encoded.bytes = {byte(0xF0 | (codePoint >> 18)),
+                     byte(0x80 | ((codePoint >> 12) & 0x3F)),
+                     byte(0x80 | ((codePoint >> 6) & 0x3F)),
+                     byte(0x80 | (codePoint & 0x3F))};
+    encoded.size = 4;
+  }
+  return encoded;
+}
+
+} // namespace zenkaku
@@ -0,0 +1,57 @@
+#pragma once
+
+/* C interface to libzenkaku. Converters are named as on the command line
+ * ("fullwidth", "circle", ...; "any" for reverse only, so forward calls
+ * with it return ZK_INVALID_ARGUMENT). All functions are thread-safe and
+ * never allocate on behalf of the caller. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum zk_status {
+  ZK_OK = 0,
+  ZK_UNKNOWN_TYPE,
+  ZK_BUFFER_TOO_SMALL,
+  ZK_INVALID_ARGUMENT
+} zk_status;
+
+typedef enum zk_direction { ZK_FORWARD = 0, ZK_REVERSE } zk_direction;
+
+/* Stores in *size the exact number of bytes converting `input` in
+ * `direction` produces. */
+zk_status zk_required_size(const char *type, const char *input, size_t length,
+                           zk_direction direction, size_t *size);
+
+/* Converts ASCII digits in `input` to `type` digits, writing at most
+ * `capacity` bytes to `output`. On ZK_OK, *written holds the output length;
+ * on ZK_BUFFER_TOO_SMALL it holds the length that would be needed. */
+zk_status zk_convert(const char *type, const char *input, size_t length,
+                     char *output, size_t capacity, size_t *written);
+
+/* Converts `type` digits in `input` back to ASCII; see zk_convert(). */
+zk_status zk_reverse(const char *type, const char *input, size_t length,
+                     char *output, size_t capacity, size_t *written);
+
+/* Converts the first `length` bytes of `buffer` in place, without a second
+ * buffer. `capacity` is the full size of `buffer` and must be at least the
+ * zk_required_size() of the text. On ZK_OK, *written holds the output
+ * length; on ZK_BUFFER_TOO_SMALL it holds the capacity needed and `buffer`
+ * is unchanged. */
+zk_status zk_convert_inplace(const char *type, char *buffer, size_t length,
+                             size_t capacity, size_t *written);
+
+/* Converts `type` digits in the first `length` bytes of `buffer` back to
+ * ASCII in place. The output is never longer than the input; its length is
+ * stored in *written. */
+zk_status zk_reverse_inplace(const char *type, char *buffer, size_t length,
+                             size_t *written);
+
+/* Human-readable description of `status`. */
+const char *zk_status_string(zk_status status);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace zenkaku {
+
+// --- UTF-8 Digit Tables ---
+// Each table holds the UTF-8 encoding of the replacement for ASCII '0'..'9'.
+using DigitTable = std::array<std::string_view, 10>;
+
+// --- Base Converter Interface ---
+// Both directions append UTF-8 bytes to `out`; no wide streams or locale
+// facets are involved. Converters are stateless and const, so one instance
+// can be shared by any number of threads.
+class DigitConverter {
+public:
+  virtual ~DigitConverter() = default;
+  virtual void convert(std::string_view input, std::string &out) const = 0;
+  virtual void reverse(std::string_view input, std::string &out) const = 0;
+  // Exact number of bytes convert()/reverse() would produce for `input`.
+  virtual size_t convertSize(std::string_view input) const = 0;
+  virtual size_t reverseSize(std::string_view input) const = 0;
+  // Write the same bytes as convert()/reverse() into `dst` and return how
+  // many were written. `dst` must hold at least convertSize()/reverseSize()
+  // bytes; nothing past the end of `dst` is touched.
+  virtual size_t convertTo(std::string_view input, std::span<char> dst) const = 0;
+  virtual size_t reverseTo(std::string_view input, std::span<char> dst) const = 0;
+  // Length of the leading run of `input` that convert()/reverse() would copy
+  // unchanged. Past it comes an ASCII digit (forward) or a 3-byte sequence
+  // (reverse), unless the run covers all of `input`.
+  virtual size_t convertPassthrough(std::string_view input) const = 0;
+  virtual size_t reversePassthrough(std::string_view input) const = 0;
+  virtual std::string getName() const = 0;
+  // UTF-8 sequences this converter emits for '0'..'9'
+  virtual const DigitTable &getDigits() const = 0;
+};
+
+// --- Converter Registry ---
+// A fixed table of converters built at compile time. Lookup is one perfect
+// hash of the name, picked by the constructor so that no two names share a
+// slot, and one compare against the single entry in that slot.
+class ConverterRegistry {
+public:
+  static constexpr size_t kMaxConverters = 8;
+
+  struct Entry {
+    std::string_view name;
+    const DigitConverter *converter;
+  };
+
+  // `entries` holds at most kMaxConverters distinct names, which
+  // getAvailableTypes() lists in the same order. Throws std::length_error
+  // for too many entries and std::invalid_argument for a repeated name, or
+  // if no seed in kMaxSeeds places every name in a slot of its own; in a
+  // constant expression, either is a compile error.
+  constexpr explicit ConverterRegistry(std::span<const Entry> entries)
+      : count(entries.size()) {
+    if (count > kMaxConverters)
+      throw std::length_error("ConverterRegistry: too many converters");
+    for (size_t k = 0; k < count; ++k) {
+      for (size_t j = 0; j < k; ++j) {
+        if (entries[j].name == entries[k].name)
+          throw std::invalid_argument("ConverterRegistry: duplicate name");
+      }
+      table[k] = entries[k];
+      names[k] = entries[k].name;
+    }
+    while (!placeAll()) {
+      if (++seed == kMaxSeeds)
+        throw std::invalid_argument("ConverterRegistry: no perfect hash");
+    }
+  }
+
+  const DigitConverter *getConverter(std::string_view name) const {
+    const Entry &entry = table[slots[slotOf(name, seed)]];
+    return entry.name == name ? entry.converter : nullptr;
+  }
+
+  std::span<const Entry> getEntries() const { return {table.data(), count}; }
+  std::span<const std::string_view> getAvailableTypes() const {
+    return {names.data(), count};
+  }
+
+private:
+  // Twice kMaxConverters, so a collision-free seed turns up in a few tries
+  static constexpr size_t kSlots = 2 * kMaxConverters;
+  // Distinct names that still collide this often are not worth placing
+  static constexpr uint32_t kMaxSeeds = 1 << 16;
+
+  // FNV-1a, offset by `seed`
+  static constexpr size_t slotOf(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return (hash ^ (hash >> 16)) % kSlots;
+  }
+
+  // Fills `slots` for the current seed; false on a collision. Empty slots
+  // point at the unnamed entry past the last one, so a miss needs no branch
+  // beyond the name compare.
+  constexpr bool placeAll() {
+    slots.fill(kMaxConverters);
+    for (size_t k = 0; k < count; ++k) {
+      size_t slot = slotOf(table[k].name, seed);
+      if (slots[slot] != kMaxConverters)
+        return false;
+      slots[slot] = static_cast<uint8_t>(k);
+    }
+    return true;
+  }
+
+  // One spare entry with an empty name and no converter
+  std::array<Entry, kMaxConverters + 1> table{};
+  std::array<std::string_view, kMaxConverters> names{};
+  std::array<uint8_t, kSlots> slots{};
+  size_t count;
+  uint32_t seed = 0;
+};
+
+// Converter that folds the digits of every converter in `registry` back to
+// ASCII in one pass. Its forward direction passes input through unchanged.
+// Throws std::invalid_argument unless every converter's digits are 3-byte
+// UTF-8 sequences.
+std::unique_ptr<DigitConverter>
+makeAnyScriptConverter(const ConverterRegistry &registry);
+
+// Process-wide registry of the built-in scripts.
+const ConverterRegistry &defaultRegistry();
+
+// Looks `type` up in defaultRegistry(), also accepting "any" for the
+// any-script converter. Returns nullptr for an unknown type.
+const DigitConverter *findConverter(std::string_view type);
+
+// --- Buffer API ---
+// Non-allocating entry points for library callers: input is read from a
+// span and output is written into a caller-supplied buffer.
+enum class Direction { Forward, Reverse };
+
+// Exact number of bytes converting `input` in `direction` produces. Only
+// counts digits (forward) or foldable sequences (reverse) with the selected
+// kernel, writing nothing, so sizing a buffer first and converting into it
+// costs less than converting into a string that has to grow.
+size_t requiredSize(const DigitConverter &converter,
+                    std::span<const char> input, Direction direction);
+
+// Converts `input` into `output` and returns the number of bytes written, or
+// std::nullopt if `output` is smaller than requiredSize().
+std::optional<size_t> convert(const DigitConverter &converter,
+                              std::span<const char> input,
+                              std::span<char> output);
+std::optional<size_t> reverse(const DigitConverter &converter,
+                              std::span<const char> input,
+                              std::span<char> output);
+
+// In-place variants for callers that cannot spare a second buffer. Both work
+// through a small stack buffer, so peak memory is the caller's buffer alone.
+//
+// Converts the first `length` bytes of `buffer` and returns the output
+// length, which requiredSize() gives in advance; `buffer` must be at least
+// that large. The text is expanded from the end backwards, so no byte is
+// overwritten before it has been read. Returns std::nullopt, with `buffer`
+// untouched, if it is too small.
+std::optional<size_t> convertInPlace(const DigitConverter &converter,
+                                     std::span<char> buffer, size_t length);
+// Folds all of `buffer` back to ASCII from the front and returns the output
+// length. The output is never longer than the input, so this cannot fail.
+size_t reverseInPlace(const DigitConverter &converter, std::span<char> buffer);
+
+// --- Kernel Selection ---
+// Implementations of the conversion hot paths, slowest to fastest. The best
+// one this build and CPU support is bound once at startup.
+enum class Kernel { Scalar, Swar, Sse42, Avx2, Avx512 };
+
+inline constexpr Kernel kKernels[] = {Kernel::Scalar, Kernel::Swar,
+                                      Kernel::Sse42, Kernel::Avx2,
+                                      Kernel::Avx512};
+
+// Name as accepted by parseKernel() and `zenkaku --kernel`.
+std::string_view kernelName(Kernel kernel);
+std::optional<Kernel> parseKernel(std::string_view name);
+
+// True if this build includes `kernel` and the CPU can run it.
+bool kernelSupported(Kernel kernel);
+
+// The kernel the conversion hot paths are currently bound to.
+Kernel activeKernel();
+
+// Binds the conversion hot paths to `kernel`. Returns false and keeps the
+// current binding if kernelSupported(kernel) is false. Not synchronised with
+// conversions in flight: call it before starting any.
+bool selectKernel(Kernel kernel);
+
+// Converts `input` in the selected direction, appending to `out`.
+inline void convertText(const DigitConverter &converter, bool reverse,
+                        std::string_view input, std::string &out) {
+  if (reverse) {
+    converter.reverse(input, out);
+  } else {
+    converter.convert(input, out);
+  }
+}
+
+// Upper bound on the output of converting `size` bytes in either direction:
+// forward turns each ASCII digit into at most three bytes, reverse never
+// grows the text.
+constexpr size_t maxOutputSize(size_t size, bool reverse) {
+  return reverse ? size : 3 * size;
+}
+
+// Converts `input` in the selected direction into `dst`, which must hold at
+// least maxOutputSize(input.size(), reverse) bytes. Returns the byte count.
+inline size_t convertTextTo(const DigitConverter &converter, bool reverse,
+                            std::string_view input, std::span<char> dst) {
+  return reverse ? converter.reverseTo(input, dst)
+                 : converter.convertTo(input, dst);
+}
+
+} // namespace zenkaku
@@ -0,0 +1,122 @@
+#include <zenkaku/zenkaku.h>
+#include <zenkaku/zenkaku.hpp>
+
+#include <span>
+#include <string_view>
+
+namespace {
+
+using zenkaku::Direction;
+
+// Resolves the converter and validates pointers shared by every entry point.
+// "any" has no forward direction, as on the command line and the daemon.
+zk_status lookup(const char *type, const char *input, size_t length,
+                 Direction direction,
+                 const zenkaku::DigitConverter *&converter) {
+  if (!type || (!input && length > 0))
+    return ZK_INVALID_ARGUMENT;
+  converter = zenkaku::findConverter(type);
+  if (!converter)
+    return ZK_UNKNOWN_TYPE;
+  if (direction == Direction::Forward && std::string_view(type) == "any")
+    return ZK_INVALID_ARGUMENT;
+  return ZK_OK;
+}
+
+zk_status transform(const char *type, const char *input, size_t length,
+                    char *output, size_t capacity, size_t *written,
+                    Direction direction) {
+  const zenkaku::DigitConverter *converter = nullptr;
+  if (zk_status status = lookup(type, input, length, direction, converter))
+    return status;
+  if (!written || (!output && capacity > 0))
+    return ZK_INVALID_ARGUMENT;
+
+  std::span<const char> in(input, length);
+  std::span<char> out(output, capacity);
+  auto n = direction == Direction::Reverse
+               ? zenkaku::reverse(*converter, in, out)
+               : zenkaku::convert(*converter, in, out);
+  if (!n) {
+    *written = zenkaku::requiredSize(*converter, in, direction);
+    return ZK_BUFFER_TOO_SMALL;
+  }
+  *written = *n;
+  return ZK_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+zk_status zk_required_size(const char *type, const char *input, size_t length,
+                           zk_direction direction, size_t *size) {
+  if (!size || (direction != ZK_FORWARD && direction != ZK_REVERSE))
+    return ZK_INVALID_ARGUMENT;
+  Direction resolved =
+      direction == ZK_REVERSE ? Direction::Reverse : Direction::Forward;
+  const zenkaku::DigitConverter *converter = nullptr;
+  if (zk_status status = lookup(type, input, length, resolved, converter))
+    return status;
+  *size = zenkaku::requiredSize(*converter, {input, length}, resolved);
+  return ZK_OK;
+}
+
+zk_status zk_convert(const char *type, const char *input, size_t length,
+                     char *output, size_t capacity, size_t *written) {
+  return transform(type, input, length, output, capacity, written,
+                   Direction::Forward);
+}
+
+zk_status zk_reverse(const char *type, const char *input, size_t length,
+                     char *output, size_t capacity, size_t *written) {
+  return transform(type, input, length, output, capacity, written,
+                   Direction::Reverse);
+}
+
+zk_status zk_convert_inplace(const char *type, char *buffer, size_t length,
+                             size_t capacity, size_t *written) {
+  const zenkaku::DigitConverter *converter = nullptr;
+  if (zk_status status =
+          lookup(type, buffer, length, Direction::Forward, converter))
+    return status;
+  if (!written || capacity < length)
+    return ZK_INVALID_ARGUMENT;
+
+  auto n = zenkaku::convertInPlace(*converter, {buffer, capacity}, length);
+  if (!n) {
+    *written = zenkaku::requiredSize(*converter, {buffer, length},
+                                     Direction::Forward);
+    return ZK_BUFFER_TOO_SMALL;
+  }
+  *written = *n;
+  return ZK_OK;
+}
+
+zk_status zk_reverse_inplace(const char *type, char *buffer, size_t length,
+                             size_t *written) {
+  const zenkaku::DigitConverter *converter = nullptr;
+  if (zk_status status =
+          lookup(type, buffer, length, Direction::Reverse, converter))
+    return status;
+  if (!written)
+    return ZK_INVALID_ARGUMENT;
+  *written = zenkaku::reverseInPlace(*converter, {buffer, length});
+  return ZK_OK;
+}
+
+const char *zk_status_string(zk_status status) {
+  switch (status) {
+  case ZK_OK:
+    return "success";
+  case ZK_UNKNOWN_TYPE:
+    return "unknown conversion type";
+  case ZK_BUFFER_TOO_SMALL:
+    return "output buffer too small";
+  case ZK_INVALID_ARGUMENT:
+    return "invalid argument";
+  }
+  return "unknown status";
+}
+
+} // extern "C"
@@ -0,0 +1,143 @@
+#include "converters.hpp"
+
+#include <zenkaku/stream.hpp>
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <variant>
+
+namespace zenkaku {
+namespace {
+
+// The built-in scripts, in name order
+constinit const ChineseConverter kChinese;
+constinit const CircleConverter kCircle;
+constinit const FullWidthConverter kFullWidth;
+constinit const RomanConverter kRoman;
+constinit const ThaiConverter kThai;
+
+constexpr ConverterRegistry::Entry kBuiltins[] = {
+    {ChineseScript::name, &kChinese},     {CircleScript::name, &kCircle},
+    {FullWidthScript::name, &kFullWidth}, {RomanScript::name, &kRoman},
+    {ThaiScript::name, &kThai},
+};
+
+constinit const ConverterRegistry kDefaultRegistry{kBuiltins};
+
+// In-place conversion stages this much output at a time
+constexpr size_t kInPlaceChunk = 16 << 10;
+
+// Tries the ResolvedConverter alternatives from index K on. The classes are
+// final, so each dynamic_cast is one type_info compare.
+template <size_t K = 1>
+ResolvedConverter resolveFrom(const DigitConverter &converter) {
+  if constexpr (K == std::variant_size_v<ResolvedConverter>) {
+    return &converter;
+  } else {
+    using Pointer = std::variant_alternative_t<K, ResolvedConverter>;
+    if (auto resolved = dynamic_cast<Pointer>(&converter))
+      return ResolvedConverter(std::in_place_index<K>, resolved);
+    return resolveFrom<K + 1>(converter);
+  }
+}
+
+} // namespace
+
+std::unique_ptr<DigitConverter>
+makeAnyScriptConverter(const ConverterRegistry &registry) {
+  return std::make_unique<AnyScriptConverter>(registry);
+}
+
+const ConverterRegistry &defaultRegistry() { return kDefaultRegistry; }
+
+const DigitConverter *findConverter(std::string_view type) {
+  if (type == "any") {
+    static const AnyScriptConverter anyScript(defaultRegistry());
+    return &anyScript;
+  }
+  return kDefaultRegistry.getConverter(type);
+}
+
+// --- Static Dispatch ---
+ResolvedConverter resolveConverter(const DigitConverter &converter) {
+  return resolveFrom(converter);
+}
+
+// --- Buffer API ---
+size_t requiredSize(const DigitConverter &converter,
+                    std::span<const char> input, Direction direction) {
+  std::string_view text(input.data(), input.size());
+  return direction == Direction::Forward ? converter.convertSize(text)
+                                         : converter.reverseSize(text);
+}
+
+std::optional<size_t> convert(const DigitConverter &converter,
+                              std::span<const char> input,
+                              std::span<char> output) {
+  // Every digit expands to at most 3 bytes, so counting is only needed when
+  // the buffer is below that bound
+  std::string_view text(input.data(), input.size());
+  if (output.size() < 3 * text.size() &&
+      output.size() < converter.convertSize(text))
+    return std::nullopt;
+  return converter.convertTo(text, output);
+}
+
+std::optional<size_t> reverse(const DigitConverter &converter,
+                              std::span<const char> input,
+                              std::span<char> output) {
+  // Reverse conversion never grows the input
+  std::string_view text(input.data(), input.size());
+  if (output.size() < text.size() &&
+      output.size() < converter.reverseSize(text))
+    return std::nullopt;
+  return converter.reverseTo(text, output);
+}
+
+std::optional<size_t> convertInPlace(const DigitConverter &converter,
+                                     std::span<char> buffer, size_t length) {
+  std::string_view text(buffer.data(), length);
+  size_t size = converter.convertSize(text);
+  if (buffer.size() < size)
+    return std::nullopt;
+
+  // The output of text[0, end) ends at `out`, two bytes past `end` per digit
+  // in it, so writing a chunk's output never reaches input not yet read.
+  // Once they meet, the rest holds no digits and is already in place.
+  std::array<char, kInPlaceChunk> scratch;
+  size_t end = length;
+  size_t out = size;
+  while (out > end) {
+    size_t start = end - std::min(end, kInPlaceChunk / 3);
+    size_t n = converter.convertTo(text.substr(start, end - start), scratch);
+    out -= n;
+    std::memcpy(buffer.data() + out, scratch.data(), n);
+    end = start;
+  }
+  return size;
+}
+
+size_t reverseInPlace(const DigitConverter &converter, std::span<char> buffer) {
+  std::string_view text(buffer.data(), buffer.size());
+  // Nothing before the first sequence changes
+  size_t in = converter.reversePassthrough(text);
+  size_t out = in;
+  std::array<char, kInPlaceChunk> scratch;
+  while (in < text.size()) {
+    std::string_view chunk = text.substr(in, kInPlaceChunk);
+    // A sequence cut at the chunk's end is folded with the next chunk
+    if (in + chunk.size() < text.size())
+      chunk.remove_suffix(incompleteUtf8Tail(chunk));
+    size_t n = converter.reverseTo(chunk, scratch);
+    std::memcpy(buffer.data() + out, scratch.data(), n);
+    out += n;
+    in += chunk.size();
+  }
+  return out;
+}
+
+} // namespace zenkaku
@@ -0,0 +1,259 @@
+#pragma once
+
+// The built-in converter types and static dispatch over them. Internal to
+// the library.
+
+#include "kernels.hpp"
+
+#include <zenkaku/utf8.hpp>
+#include <zenkaku/zenkaku.hpp>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace zenkaku {
+
+// --- Script Definitions ---
+// Each script lists the code points for '0'..'9'. They are encoded into a
+// constexpr table of UTF-8 sequences, from which the forward expansion table
+// and the reverse trie are both generated at compile time.
+template <char32_t... CodePoints> struct EncodedDigits {
+  static_assert(sizeof...(CodePoints) == 10, "one code point per digit");
+  // The table's views point into these
+  static constexpr std::array<Utf8Char, 10> encoded = {
+      encodeUtf8(CodePoints)...};
+  static constexpr DigitTable table = [] {
+    DigitTable table;
+    for (size_t d = 0; d < table.size(); ++d) {
+      table[d] = encoded[d].view();
+    }
+    return table;
+  }();
+};
+
+struct FullWidthScript {
+  static constexpr std::string_view name = "fullwidth";
+  // U+FF10 to U+FF19
+  static constexpr DigitTable digits =
+      EncodedDigits<U'０', U'１', U'２', U'３', U'４', U'５', U'６', U'７',
+                    U'８', U'９'>::table;
+};
+
+struct CircleScript {
+  static constexpr std::string_view name = "circle";
+  // U+24EA, then U+2460 to U+2468
+  static constexpr DigitTable digits =
+      EncodedDigits<U'⓪', U'①', U'②', U'③', U'④', U'⑤', U'⑥', U'⑦',
+                    U'⑧', U'⑨'>::table;
+};
+
+struct RomanScript {
+  static constexpr std::string_view name = "roman";
+  // Fullwidth zero (U+FF10), then U+2160 to U+2168
+  static constexpr DigitTable digits =
+      EncodedDigits<U'０', U'Ⅰ', U'Ⅱ', U'Ⅲ', U'Ⅳ', U'Ⅴ', U'Ⅵ', U'Ⅶ',
+                    U'Ⅷ', U'Ⅸ'>::table;
+};
+
+struct ChineseScript {
+  static constexpr std::string_view name = "chinese";
+  static constexpr DigitTable digits =
+      EncodedDigits<U'〇', U'一', U'二', U'三', U'四', U'五', U'六', U'七',
+                    U'八', U'九'>::table;
+};
+
+struct ThaiScript {
+  static constexpr std::string_view name = "thai";
+  // U+0E50 to U+0E59
+  static constexpr DigitTable digits =
+      EncodedDigits<U'๐', U'๑', U'๒', U'๓', U'๔', U'๕', U'๖', U'๗',
+                    U'๘', U'๙'>::table;
+};
+
+// --- Table-Driven Converter ---
+// One converter for every script: the same forward kernel and the same
+// reverse scanner, specialised by the script's compile-time tables.
+template <typename Script> class TableConverter final : public DigitConverter {
+private:
+  static_assert(isThreeByteTable(Script::digits),
+                "digit tables must hold 3-byte UTF-8 sequences");
+  static constexpr ExpansionTable forward = makeExpansionTable(Script::digits);
+  static constexpr DigitTrie backward{Script::digits};
+
+public:
+  void convert(std::string_view input, std::string &out) const override {
+    expandDigits(input, out, forward);
+  }
+
+  void reverse(std::string_view input, std::string &out) const override {
+    reverseDigits(input, out, backward);
+  }
+
+  size_t convertSize(std::string_view input) const override {
+    return input.size() + 2 * countDigits(input);
+  }
+
+  size_t reverseSize(std::string_view input) const override {
+    return input.size() - 2 * countSequences(input, backward);
+  }
+
+  size_t convertTo(std::string_view input, std::span<char> dst) const override {
+    return static_cast<size_t>(
+        expandDigitsTo(input, dst.data(), dst.data() + dst.size(), forward) -
+        dst.data());
+  }
+
+  size_t reverseTo(std::string_view input, std::span<char> dst) const override {
+    return static_cast<size_t>(reverseDigitsTo(input, dst.data(), backward) -
+                               dst.data());
+  }
+
+  size_t convertPassthrough(std::string_view input) const override {
+    return findDigit(input, 0);
+  }
+
+  size_t reversePassthrough(std::string_view input) const override {
+    return findSequence(input, backward);
+  }
+
+  std::string getName() const override { return std::string(Script::name); }
+  const DigitTable &getDigits() const override { return Script::digits; }
+};
+
+using FullWidthConverter = TableConverter<FullWidthScript>;
+using CircleConverter = TableConverter<CircleScript>;
+using RomanConverter = TableConverter<RomanScript>;
+using ChineseConverter = TableConverter<ChineseScript>;
+using ThaiConverter = TableConverter<ThaiScript>;
+
+// --- Any-Script Reverse Converter ---
+// Folds the digits of every registered converter back to ASCII in one pass.
+// All tables are merged into one DigitTrie, so lookup cost is the same
+// however many scripts are registered.
+class AnyScriptConverter final : public DigitConverter {
+private:
+  DigitTrie trie;
+
+public:
+  // Throws std::invalid_argument if a converter's digits are not all 3-byte
+  // sequences, which is all the trie can hold.
+  explicit AnyScriptConverter(const ConverterRegistry &registry) {
+    for (const ConverterRegistry::Entry &entry : registry.getEntries()) {
+      const DigitTable &digits = entry.converter->getDigits();
+      if (!isThreeByteTable(digits))
+        throw std::invalid_argument(
+            "AnyScriptConverter: digits of '" + std::string(entry.name) +
+            "' are not 3-byte sequences");
+      trie.add(digits);
+    }
+  }
+
+  // There is no single forward form for "any"; input is passed through.
+  void convert(std::string_view input, std::string &out) const override {
+    out.append(input);
+  }
+
+  void reverse(std::string_view input, std::string &out) const override {
+    reverseDigits(input, out, trie);
+  }
+
+  size_t convertSize(std::string_view input) const override {
+    return input.size();
+  }
+
+  size_t reverseSize(std::string_view input) const override {
+    return input.size() - 2 * countSequences(input, trie);
+  }
+
+  size_t convertTo(std::string_view input, std::span<char> dst) const override {
+    std::copy(input.begin(), input.end(), dst.begin());
+    return input.size();
+  }
+
+  size_t reverseTo(std::string_view input, std::span<char> dst) const override {
+    return static_cast<size_t>(reverseDigitsTo(input, dst.data(), trie) -
+                               dst.data());
+  }
+
+  size_t convertPassthrough(std::string_view input) const override {
+    return input.size();
+  }
+
+  size_t reversePassthrough(std::string_view input) const override {
+    return findSequence(input, trie);
+  }
+
+  std::string getName() const override { return "any"; }
+  const DigitTable &getDigits() const override {
+    static constexpr DigitTable ascii = {"0", "1", "2", "3", "4",
+                                         "5", "6", "7", "8", "9"};
+    return ascii;
+  }
+};
+
+// --- Static Dispatch ---
+// A DigitConverter resolved to its concrete type. Every built-in converter
+// class is final, so calls through one of these pointers are direct and
+// their tables and kernels inline into the caller. Any other converter keeps
+// the virtual interface.
+using ResolvedConverter =
+    std::variant<const DigitConverter *, const ChineseConverter *,
+                 const CircleConverter *, const FullWidthConverter *,
+                 const RomanConverter *, const ThaiConverter *,
+                 const AnyScriptConverter *>;
+
+// Resolves `converter` to its concrete type, or to the DigitConverter
+// alternative if it is not one of the built-in classes.
+ResolvedConverter resolveConverter(const DigitConverter &converter);
+
+// A converter with its type and direction both fixed at compile time.
+template <typename Converter, bool Reverse> struct DirectedConverter {
+  static constexpr bool reverse = Reverse;
+
+  const Converter &converter;
+
+  // convertTextTo() for this direction
+  size_t operator()(std::string_view input, std::span<char> dst) const {
+    if constexpr (Reverse) {
+      return converter.reverseTo(input, dst);
+    } else {
+      return converter.convertTo(input, dst);
+    }
+  }
+
+  // convertPassthrough() or reversePassthrough()
+  size_t passthrough(std::string_view input) const {
+    if constexpr (Reverse) {
+      return converter.reversePassthrough(input);
+    } else {
+      return converter.convertPassthrough(input);
+    }
+  }
+};
+
+// Calls `visitor` with a DirectedConverter for `converter` and `reverse`.
+// The type is looked up once here, so a loop inside `visitor` is compiled
+// once per converter class and direction, with no virtual calls in it.
+// StreamConverter and MappedFileConverter run their loops this way; the
+// block engines call the converter once per block and do not.
+template <typename Visitor>
+decltype(auto) visitConverter(const DigitConverter &converter, bool reverse,
+                              Visitor &&visitor) {
+  return std::visit(
+      [&](auto resolved) -> decltype(auto) {
+        using Converter = std::remove_pointer_t<decltype(resolved)>;
+        if (reverse)
+          return visitor(DirectedConverter<Converter, true>{*resolved});
+        return visitor(DirectedConverter<Converter, false>{*resolved});
+      },
+      resolveConverter(converter));
+}
+
+} // namespace zenkaku
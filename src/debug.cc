@@ -0,0 +1,33 @@
+// Counting replacement for the global allocation functions, compiled in
+// only with ZENKAKU_COUNT_ALLOCATIONS.
+
+#include <zenkaku/debug.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace zenkaku {
+namespace {
+thread_local size_t allocations = 0;
+} // namespace
+
+size_t threadAllocationCount() { return allocations; }
+
+void unexpectedAllocation(const char *where) {
+  std::fprintf(stderr, "zenkaku: heap allocation in %s\n", where);
+  std::abort();
+}
+
+} // namespace zenkaku
+
+// The array, nothrow and sized forms all forward to these two
+void *operator new(size_t size) {
+  ++zenkaku::allocations;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
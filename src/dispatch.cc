@@ -0,0 +1,94 @@
+#include "kernels.hpp"
+
+namespace zenkaku {
+
+// Scalar until the startup probe below runs, so conversions from other
+// static initializers are still correct
+constinit KernelSet activeKernels = kScalarKernels;
+
+namespace {
+
+constexpr std::string_view kKernelNames[] = {"scalar", "swar", "sse4.2",
+                                               "avx2", "avx512"};
+static_assert(std::size(kKernelNames) == std::size(kKernels));
+
+const KernelSet *kernelSet(Kernel kernel) {
+  switch (kernel) {
+  case Kernel::Scalar:
+    return &kScalarKernels;
+  case Kernel::Swar:
+    return &kSwarKernels;
+#ifdef ZENKAKU_X86_KERNELS
+  case Kernel::Sse42:
+    return &kSse42Kernels;
+  case Kernel::Avx2:
+    return &kAvx2Kernels;
+  case Kernel::Avx512:
+    return &kAvx512Kernels;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+bool cpuSupports(Kernel kernel) {
+#ifdef ZENKAKU_X86_KERNELS
+  // __builtin_cpu_supports() also checks that the OS saves the wider
+  // registers, not just the CPUID bits
+  switch (kernel) {
+  case Kernel::Sse42:
+    return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3");
+  case Kernel::Avx2:
+    return __builtin_cpu_supports("avx2");
+  case Kernel::Avx512:
+    return __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vbmi") &&
+           __builtin_cpu_supports("avx512vbmi2") &&
+           __builtin_cpu_supports("bmi2");
+  default:
+    break;
+  }
+#endif
+  return kernel == Kernel::Scalar || kernel == Kernel::Swar;
+}
+
+Kernel bestKernel() {
+  Kernel best = Kernel::Scalar;
+  for (Kernel kernel : kKernels) {
+    if (kernelSupported(kernel))
+      best = kernel;
+  }
+  return best;
+}
+
+// Probes the CPU once, before main()
+const bool probed = selectKernel(bestKernel());
+
+} // namespace
+
+std::string_view kernelName(Kernel kernel) {
+  return kKernelNames[static_cast<size_t>(kernel)];
+}
+
+std::optional<Kernel> parseKernel(std::string_view name) {
+  for (Kernel kernel : kKernels) {
+    if (kernelName(kernel) == name)
+      return kernel;
+  }
+  return std::nullopt;
+}
+
+bool kernelSupported(Kernel kernel) {
+  return kernelSet(kernel) && cpuSupports(kernel);
+}
+
+Kernel activeKernel() { return activeKernels.kernel; }
+
+bool selectKernel(Kernel kernel) {
+  if (!kernelSupported(kernel))
+    return false;
+  activeKernels = *kernelSet(kernel);
+  return true;
+}
+
+} // namespace zenkaku
@@ -0,0 +1,361 @@
+#pragma once
+
+// Conversion kernels shared by every converter: forward digit expansion,
+// lead-byte scanning and the reverse digit trie. Internal to the library.
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// x86 SIMD kernels live in kernels_x86.cc and are bound at run time
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ZENKAKU_X86_KERNELS 1
+#endif
+
+namespace zenkaku {
+
+// --- UTF-8 Digit Tables ---
+// True if every entry is a 3-byte UTF-8 sequence (lead byte 0xE0..0xEF).
+// The forward kernels and the reverse trie rely on this shape.
+constexpr bool isThreeByteTable(const DigitTable &table) {
+  for (std::string_view sequence : table) {
+    if (sequence.size() != 3 ||
+        (static_cast<unsigned char>(sequence[0]) & 0xF0) != 0xE0)
+      return false;
+  }
+  return true;
+}
+
+// Forward lookup data generated from a DigitTable at compile time.
+// lanes[k][d] is byte k of the replacement for digit d, laid out as 16-byte
+// vectors so the SIMD kernels can fetch replacements with pshufb. packed[c]
+// holds the output for input byte c in its first bytes in memory order: the
+// replacement for a digit, c itself otherwise.
+struct ExpansionTable {
+  DigitTable utf8;
+  std::array<std::array<uint8_t, 16>, 3> lanes;
+  std::array<uint32_t, 256> packed;
+};
+
+constexpr ExpansionTable makeExpansionTable(const DigitTable &table) {
+  ExpansionTable expansion{table, {}, {}};
+  for (size_t d = 0; d < table.size(); ++d) {
+    for (size_t k = 0; k < 3; ++k) {
+      expansion.lanes[k][d] = static_cast<uint8_t>(table[d][k]);
+    }
+  }
+  for (uint32_t c = 0; c < 256; ++c) {
+    std::array<uint8_t, 4> bytes{static_cast<uint8_t>(c)};
+    if (c >= '0' && c <= '9') {
+      for (size_t k = 0; k < 3; ++k) {
+        bytes[k] = static_cast<uint8_t>(table[c - '0'][k]);
+      }
+    }
+    expansion.packed[c] = std::bit_cast<uint32_t>(bytes);
+  }
+  return expansion;
+}
+
+// Writes `input` to `dst`, replacing every ASCII digit with its entry in
+// `table`, and returns the end of the output. Runs without digits are copied
+// in one memcpy. This is the portable fallback and the reference for the
+// vectorised kernels.
+inline char *expandDigitsScalar(std::string_view input, char *dst,
+                                const DigitTable &table) {
+  size_t start = 0;
+  for (size_t i = 0; i < input.size(); ++i) {
+    char ch = input[i];
+    if (ch >= '0' && ch <= '9') {
+      std::memcpy(dst, input.data() + start, i - start);
+      dst += i - start;
+      std::string_view replacement = table[ch - '0'];
+      std::memcpy(dst, replacement.data(), replacement.size());
+      dst += replacement.size();
+      start = i + 1;
+    }
+  }
+  if (start == input.size())
+    return dst;
+  std::memcpy(dst, input.data() + start, input.size() - start);
+  return dst + (input.size() - start);
+}
+
+// Number of ASCII digits in `input`. Forward conversion of a 3-byte table
+// grows the input by exactly two bytes per digit.
+inline size_t countDigitsScalar(std::string_view input) {
+  return static_cast<size_t>(std::count_if(
+      input.begin(), input.end(), [](char ch) { return ch >= '0' && ch <= '9'; }));
+}
+
+// Returns the position of the first ASCII digit at or after `from`, or
+// input.size() if there is none.
+inline size_t findDigitScalar(std::string_view input, size_t from) {
+  for (size_t i = from; i < input.size(); ++i) {
+    if (input[i] >= '0' && input[i] <= '9')
+      return i;
+  }
+  return input.size();
+}
+
+// --- Reverse Lead-Byte Scanner ---
+// Every converted digit is a 3-byte UTF-8 sequence, so its lead byte lies in
+// 0xE0..0xEF. A LeadByteSet marks the lead bytes a converter can match, one
+// bit per low nibble.
+using LeadByteSet = uint16_t;
+
+constexpr LeadByteSet leadByteSet(std::initializer_list<unsigned char> bytes) {
+  LeadByteSet set = 0;
+  for (unsigned char byte : bytes) {
+    set |= static_cast<LeadByteSet>(1u << (byte & 0x0F));
+  }
+  return set;
+}
+
+inline bool isLeadByte(unsigned char byte, LeadByteSet leads) {
+  return (byte & 0xF0) == 0xE0 && ((leads >> (byte & 0x0F)) & 1);
+}
+
+// Returns the position of the first byte at or after `from` that is in
+// `leads`, or input.size() if there is none.
+inline size_t findLeadByteScalar(std::string_view input, size_t from,
+                                 LeadByteSet leads) {
+  for (size_t i = from; i < input.size(); ++i) {
+    if (isLeadByte(static_cast<unsigned char>(input[i]), leads))
+      return i;
+  }
+  return input.size();
+}
+
+// --- Reverse Digit Trie ---
+// Maps 3-byte digit sequences back to ASCII. The lead byte's low nibble and
+// the second byte select a row; the third byte indexes into it. Tables are
+// built at compile time for each script and at run time for the any-script
+// converter, which merges every registered table into one trie.
+class DigitTrie {
+public:
+  static constexpr size_t kMaxRows = 32;
+
+  constexpr DigitTrie() = default;
+  constexpr explicit DigitTrie(const DigitTable &table) { add(table); }
+
+  // Adds every entry of `table`. An existing mapping for a sequence wins.
+  constexpr void add(const DigitTable &table) {
+    for (size_t d = 0; d < table.size(); ++d) {
+      add(table[d], static_cast<char>('0' + d));
+    }
+  }
+
+  constexpr void add(std::string_view sequence, char digit) {
+    auto b0 = static_cast<unsigned char>(sequence[0]);
+    auto b1 = static_cast<unsigned char>(sequence[1]);
+    auto b2 = static_cast<unsigned char>(sequence[2]);
+    uint8_t &row = prefixes[prefixIndex(b0, b1)];
+    if (row == 0) {
+      if (rowCount == kMaxRows)
+        throw std::length_error("DigitTrie: too many sequence prefixes");
+      row = static_cast<uint8_t>(++rowCount);
+    }
+    char &slot = rows[row - 1][b2 & 0x3F];
+    if (slot == '\0')
+      slot = digit;
+    leads |= leadByteSet({b0});
+  }
+
+  // Returns the ASCII digit for the 3 bytes at `p`, or '\0' if they are not
+  // a known sequence. `p[0]` must already be in leadBytes().
+  char match(const unsigned char *p) const {
+    if ((p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80)
+      return '\0';
+    uint8_t row = prefixes[prefixIndex(p[0], p[1])];
+    return row ? rows[row - 1][p[2] & 0x3F] : '\0';
+  }
+
+  constexpr LeadByteSet leadBytes() const { return leads; }
+
+private:
+  static constexpr size_t prefixIndex(unsigned char b0, unsigned char b1) {
+    return static_cast<size_t>(b0 & 0x0F) << 6 | (b1 & 0x3F);
+  }
+
+  // Row number + 1 for each (lead nibble, second byte) prefix, 0 if unused
+  std::array<uint8_t, 16 * 64> prefixes{};
+  std::array<std::array<char, 64>, kMaxRows> rows{};
+  uint8_t rowCount = 0;
+  LeadByteSet leads = 0;
+};
+
+// Writes `input` to `dst` with the sequences known to `trie` folded back to
+// ASCII, and returns the end of the output, which is never longer than the
+// input. Bytes between candidate lead bytes are copied in bulk; the trie is
+// consulted only at candidates, which `FindLeadByte` locates.
+template <size_t (*FindLeadByte)(std::string_view, size_t, LeadByteSet)>
+char *reverseDigitsWith(std::string_view input, char *dst,
+                        const DigitTrie &trie) {
+  const LeadByteSet leads = trie.leadBytes();
+  size_t i = 0;
+  while (i < input.size()) {
+    size_t next = FindLeadByte(input, i, leads);
+    if (next + 2 >= input.size()) {
+      // No room for a whole sequence; the rest is copied unchanged
+      next = input.size();
+    }
+    std::memcpy(dst, input.data() + i, next - i);
+    dst += next - i;
+    if (next == input.size())
+      break;
+
+    auto bytes = reinterpret_cast<const unsigned char *>(input.data() + next);
+    if (char digit = trie.match(bytes)) {
+      *dst++ = digit;
+      i = next + 3;
+    } else {
+      *dst++ = input[next];
+      i = next + 1;
+    }
+  }
+  return dst;
+}
+
+// Number of sequences in `input` that reverseDigitsWith() would fold. The
+// continuation bytes of a folded sequence are never lead bytes, so every
+// candidate can be tried on its own, without tracking where the previous
+// match ended.
+template <size_t (*FindLeadByte)(std::string_view, size_t, LeadByteSet)>
+size_t countSequencesWith(std::string_view input, const DigitTrie &trie) {
+  const LeadByteSet leads = trie.leadBytes();
+  size_t count = 0;
+  size_t i = 0;
+  while (true) {
+    size_t next = FindLeadByte(input, i, leads);
+    if (next + 2 >= input.size())
+      return count;
+    if (trie.match(reinterpret_cast<const unsigned char *>(input.data() +
+                                                           next)))
+      ++count;
+    i = next + 1;
+  }
+}
+
+// --- Kernel Dispatch ---
+// One implementation of each hot path per Kernel tier. activeKernels starts
+// out scalar and is rebound once at startup to the best tier the CPU
+// supports, or later by selectKernel().
+struct KernelSet {
+  Kernel kernel;
+  // Forward conversion of `input` into `dst`, returning the end of the
+  // output. Nothing at or past `dstEnd` is touched, which must leave room
+  // for input.size() + 2 * countDigits(input) bytes.
+  char *(*expand)(std::string_view input, char *dst, const char *dstEnd,
+                  const ExpansionTable &table);
+  // First ASCII digit at or after `from`, or input.size()
+  size_t (*findDigit)(std::string_view input, size_t from);
+  // First byte in `leads` at or after `from`, or input.size()
+  size_t (*findLeadByte)(std::string_view input, size_t from,
+                         LeadByteSet leads);
+  // Reverse conversion of `input` into `dst`, returning the end of the
+  // output, which is never longer than the input.
+  char *(*reverse)(std::string_view input, char *dst, const DigitTrie &trie);
+  // Exact sizing passes, which write nothing: ASCII digits in `input`, and
+  // sequences that reverse() would fold
+  size_t (*countDigits)(std::string_view input);
+  size_t (*countSequences)(std::string_view input, const DigitTrie &trie);
+};
+
+extern KernelSet activeKernels;
+
+inline char *expandDigitsScalarTo(std::string_view input, char *dst,
+                                  const char *, const ExpansionTable &table) {
+  return expandDigitsScalar(input, dst, table.utf8);
+}
+
+inline constexpr KernelSet kScalarKernels{
+    Kernel::Scalar,
+    expandDigitsScalarTo,
+    findDigitScalar,
+    findLeadByteScalar,
+    reverseDigitsWith<findLeadByteScalar>,
+    countDigitsScalar,
+    countSequencesWith<findLeadByteScalar>};
+
+extern const KernelSet kSwarKernels;
+#ifdef ZENKAKU_X86_KERNELS
+extern const KernelSet kSse42Kernels;
+extern const KernelSet kAvx2Kernels;
+extern const KernelSet kAvx512Kernels;
+#endif
+
+inline char *expandDigitsTo(std::string_view input, char *dst,
+                            const char *dstEnd, const ExpansionTable &table) {
+  return activeKernels.expand(input, dst, dstEnd, table);
+}
+
+inline size_t findDigit(std::string_view input, size_t from) {
+  return activeKernels.findDigit(input, from);
+}
+
+inline size_t findLeadByte(std::string_view input, size_t from,
+                           LeadByteSet leads) {
+  return activeKernels.findLeadByte(input, from, leads);
+}
+
+inline char *reverseDigitsTo(std::string_view input, char *dst,
+                             const DigitTrie &trie) {
+  return activeKernels.reverse(input, dst, trie);
+}
+
+inline size_t countDigits(std::string_view input) {
+  return activeKernels.countDigits(input);
+}
+
+// Number of sequences in `input` that reverseDigitsTo() would fold. Each one
+// shrinks the output by two bytes.
+inline size_t countSequences(std::string_view input, const DigitTrie &trie) {
+  return activeKernels.countSequences(input, trie);
+}
+
+// Appends the forward conversion of `input` to `out`.
+inline void expandDigits(std::string_view input, std::string &out,
+                         const ExpansionTable &table) {
+  size_t base = out.size();
+  out.resize_and_overwrite(base + 3 * input.size(), [&](char *data,
+                                                        size_t size) {
+    return static_cast<size_t>(
+        expandDigitsTo(input, data + base, data + size, table) - data);
+  });
+}
+
+// Returns the position of the first sequence in `input` that
+// reverseDigitsTo() would fold, or input.size() if there is none.
+inline size_t findSequence(std::string_view input, const DigitTrie &trie) {
+  const LeadByteSet leads = trie.leadBytes();
+  size_t i = 0;
+  while (true) {
+    size_t next = findLeadByte(input, i, leads);
+    if (next + 2 >= input.size())
+      return input.size();
+    if (trie.match(reinterpret_cast<const unsigned char *>(input.data() +
+                                                           next)))
+      return next;
+    i = next + 1;
+  }
+}
+
+// Appends `input` to `out` with the sequences known to `trie` folded back.
+inline void reverseDigits(std::string_view input, std::string &out,
+                          const DigitTrie &trie) {
+  size_t base = out.size();
+  out.resize_and_overwrite(base + input.size(), [&](char *data, size_t) {
+    return static_cast<size_t>(reverseDigitsTo(input, data + base, trie) -
+                               data);
+  });
+}
+
+} // namespace zenkaku
@@ -0,0 +1,199 @@
+// SWAR tier of the conversion kernels: eight bytes per step in a 64-bit
+// general-purpose register. Portable to every target and the fastest tier
+// where SIMD is unavailable or masked off.
+
+#include "kernels.hpp"
+
+namespace zenkaku {
+namespace {
+
+constexpr uint64_t kOnes = 0x0101010101010101ull;
+constexpr uint64_t kHighBits = 0x80 * kOnes;
+constexpr uint64_t kLow7 = 0x7F * kOnes;
+
+// Eight bytes at `p`, with p[0] in the least significant byte on every
+// platform so that flag positions map to offsets the same way.
+inline uint64_t loadWord(const char *p) {
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  if constexpr (std::endian::native == std::endian::big)
+    word = std::byteswap(word);
+  return word;
+}
+
+// Offset of the first byte flagged in `flags` (bit 7 of each byte).
+inline size_t firstFlag(uint64_t flags) {
+  return static_cast<size_t>(std::countr_zero(flags)) / 8;
+}
+
+// Sets bit 7 of every byte of `word` that is an ASCII digit. Each byte is
+// tested on its low seven bits with additions that cannot carry into the
+// next byte, so the flags are exact.
+inline uint64_t digitFlags(uint64_t word) {
+  uint64_t low = word & kLow7;
+  uint64_t atLeastZero = low + (0x80 - '0') * kOnes;
+  uint64_t aboveNine = low + (0x80 - '9' - 1) * kOnes;
+  return atLeastZero & ~aboveNine & ~word & kHighBits;
+}
+
+// Sets bit 7 of every zero byte of `word`. The low seven bits are summed
+// without carries between bytes, so the flags are exact.
+inline uint64_t zeroByteFlags(uint64_t word) {
+  return ~(((word & kLow7) + kLow7) | word) & kHighBits;
+}
+
+// The lead bytes of a LeadByteSet, each broadcast to all eight bytes of a
+// word. Scripts use one to three leads, so testing a word against each is
+// cheaper than a per-byte nibble lookup.
+struct LeadWords {
+  explicit LeadWords(LeadByteSet leads) {
+    for (unsigned nibble = 0; nibble < 16; ++nibble) {
+      if ((leads >> nibble) & 1)
+        words[count++] = (0xE0 | nibble) * kOnes;
+    }
+  }
+
+  // Sets bit 7 of every byte of `word` that is one of the leads.
+  uint64_t flags(uint64_t word) const {
+    uint64_t flags = 0;
+    for (size_t k = 0; k < count; ++k) {
+      flags |= zeroByteFlags(word ^ words[k]);
+    }
+    return flags;
+  }
+
+  uint64_t words[16];
+  size_t count = 0;
+};
+
+size_t findDigitSwar(std::string_view input, size_t from) {
+  size_t i = from;
+  for (; i + 8 <= input.size(); i += 8) {
+    if (uint64_t flags = digitFlags(loadWord(input.data() + i)))
+      return i + firstFlag(flags);
+  }
+  return findDigitScalar(input, i);
+}
+
+size_t findLeadByteSwar(std::string_view input, size_t from,
+                        LeadByteSet leads) {
+  const LeadWords leadWords(leads);
+  size_t i = from;
+  for (; i + 8 <= input.size(); i += 8) {
+    if (uint64_t flags = leadWords.flags(loadWord(input.data() + i)))
+      return i + firstFlag(flags);
+  }
+  return findLeadByteScalar(input, i, leads);
+}
+
+// Copies digit-free words whole. Words with a digit go byte by byte without
+// branches: each byte stores its 4-byte packed entry and advances by 1 or 3,
+// the next store overwriting the spare bytes. That needs 25 bytes of room
+// per word; near `dstEnd` the remaining words take the exact scalar path.
+char *expandDigitsSwar(std::string_view input, char *dst, const char *dstEnd,
+                       const ExpansionTable &table) {
+  constexpr size_t kWordFootprint = 8 * 3 + 1;
+  const char *src = input.data();
+  size_t i = 0;
+  for (; i + 8 <= input.size() &&
+         static_cast<size_t>(dstEnd - dst) >= kWordFootprint;
+       i += 8) {
+    if (digitFlags(loadWord(src + i)) == 0) {
+      std::memcpy(dst, src + i, 8);
+      dst += 8;
+      continue;
+    }
+    for (size_t k = i; k < i + 8; ++k) {
+      auto c = static_cast<unsigned char>(src[k]);
+      std::memcpy(dst, &table.packed[c], 4);
+      dst += 1 + 2 * (static_cast<unsigned>(c - '0') < 10);
+    }
+  }
+  return expandDigitsScalar(input.substr(i), dst, table.utf8);
+}
+
+// Copies words without a lead byte whole. In a word with leads, each one is
+// tried against `trie` in turn and the bytes between them are copied. A
+// folded sequence may run into the next word, which then resumes after it.
+char *reverseDigitsSwar(std::string_view input, char *dst,
+                        const DigitTrie &trie) {
+  const LeadWords leadWords(trie.leadBytes());
+  const char *src = input.data();
+  const size_t size = input.size();
+  size_t i = 0;
+  while (i + 8 <= size) {
+    const size_t word = i;
+    uint64_t flags = leadWords.flags(loadWord(src + word));
+    if (flags == 0) {
+      std::memcpy(dst, src + word, 8);
+      dst += 8;
+      i += 8;
+      continue;
+    }
+    for (; flags != 0; flags &= flags - 1) {
+      size_t at = word + firstFlag(flags);
+      if (at < i)
+        continue; // inside a sequence folded just before
+      // Gaps are under eight bytes; a byte loop beats a memcpy call
+      while (i < at) {
+        *dst++ = src[i++];
+      }
+      char digit = '\0';
+      if (at + 2 < size)
+        digit = trie.match(reinterpret_cast<const unsigned char *>(src + at));
+      if (digit) {
+        *dst++ = digit;
+        i = at + 3;
+      } else {
+        *dst++ = src[at];
+        i = at + 1;
+      }
+    }
+    while (i < word + 8) {
+      *dst++ = src[i++];
+    }
+  }
+  return reverseDigitsWith<findLeadByteScalar>(input.substr(i), dst, trie);
+}
+
+// One flag per digit. Shifted down to 0 or 1 per byte, a multiply by kOnes
+// sums the eight bytes into the top one, which is cheaper than a popcount
+// where the baseline ISA has no instruction for it.
+size_t countDigitsSwar(std::string_view input) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= input.size(); i += 8) {
+    uint64_t flags = digitFlags(loadWord(input.data() + i));
+    count += static_cast<size_t>(((flags >> 7) * kOnes) >> 56);
+  }
+  return count + countDigitsScalar(input.substr(i));
+}
+
+// Tries every lead byte flagged in a word; see countSequencesWith() for why
+// no candidate needs to be skipped.
+size_t countSequencesSwar(std::string_view input, const DigitTrie &trie) {
+  const LeadWords leadWords(trie.leadBytes());
+  const char *src = input.data();
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= input.size(); i += 8) {
+    for (uint64_t flags = leadWords.flags(loadWord(src + i)); flags != 0;
+         flags &= flags - 1) {
+      size_t at = i + firstFlag(flags);
+      if (at + 2 < input.size() &&
+          trie.match(reinterpret_cast<const unsigned char *>(src + at)))
+        ++count;
+    }
+  }
+  return count +
+         countSequencesWith<findLeadByteScalar>(input.substr(i), trie);
+}
+
+} // namespace
+
+const KernelSet kSwarKernels{Kernel::Swar,       expandDigitsSwar,
+                             findDigitSwar,      findLeadByteSwar,
+                             reverseDigitsSwar,  countDigitsSwar,
+                             countSequencesSwar};
+
+} // namespace zenkaku
@@ -0,0 +1,498 @@
+// x86 SIMD tiers of the conversion kernels. Each function carries its own
+// target attribute, so this file builds for the baseline ISA and the
+// dispatcher decides at run time which tier may execute.
+
+#include "kernels.hpp"
+
+#ifdef ZENKAKU_X86_KERNELS
+#include <immintrin.h>
+
+namespace zenkaku {
+namespace {
+
+// --- Forward Expansion ---
+// pshufb controls that expand 8 input bytes into at most 24 output bytes for
+// one 8-bit digit mask. Source A holds the 8 input bytes followed by the 8
+// first bytes of their replacements; source B holds the 8 second bytes
+// followed by the 8 third bytes. Lanes set to 0x80 read as zero, so each
+// output vector is shuffle(A) | shuffle(B).
+struct ExpandShuffle {
+  std::array<uint8_t, 16> lowA, lowB, highA, highB;
+  uint8_t length;
+};
+
+constexpr std::array<ExpandShuffle, 256> makeExpandShuffles() {
+  std::array<ExpandShuffle, 256> shuffles{};
+  for (unsigned mask = 0; mask < 256; ++mask) {
+    std::array<uint8_t, 32> a{}, b{};
+    a.fill(0x80);
+    b.fill(0x80);
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+      if (mask & (1u << i)) {
+        a[n++] = 8 + i;
+        b[n++] = i;
+        b[n++] = 8 + i;
+      } else {
+        a[n++] = i;
+      }
+    }
+    ExpandShuffle &s = shuffles[mask];
+    std::copy_n(a.begin(), 16, s.lowA.begin());
+    std::copy_n(b.begin(), 16, s.lowB.begin());
+    std::copy_n(a.begin() + 16, 16, s.highA.begin());
+    std::copy_n(b.begin() + 16, 16, s.highB.begin());
+    s.length = n;
+  }
+  return shuffles;
+}
+
+constexpr auto kExpandShuffles = makeExpandShuffles();
+
+// Store footprint of one 8-byte group: two 16-byte stores, of which at most
+// 24 bytes are kept.
+constexpr size_t kGroupFootprint = 32;
+
+__attribute__((target("sse4.2"))) inline __m128i
+loadControl(const std::array<uint8_t, 16> &control) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(control.data()));
+}
+
+// Expands one 8-byte group (sources A and B, see ExpandShuffle) with digit
+// mask `mask` to `dst` and advances it past the bytes produced.
+__attribute__((target("sse4.2"))) inline void
+expandGroup(__m128i a, __m128i b, unsigned mask, char *&dst) {
+  const ExpandShuffle &s = kExpandShuffles[mask];
+  __m128i low = _mm_or_si128(_mm_shuffle_epi8(a, loadControl(s.lowA)),
+                             _mm_shuffle_epi8(b, loadControl(s.lowB)));
+  __m128i high = _mm_or_si128(_mm_shuffle_epi8(a, loadControl(s.highA)),
+                              _mm_shuffle_epi8(b, loadControl(s.highB)));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), low);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), high);
+  dst += s.length;
+}
+
+// Expands the 16 bytes `v`, whose digits are flagged in `mask`, using the
+// replacement bytes t0..t2 looked up for each lane.
+__attribute__((target("sse4.2"))) inline void
+expandBlock16(__m128i v, __m128i t0, __m128i t1, __m128i t2, unsigned mask,
+              char *&dst) {
+  expandGroup(_mm_unpacklo_epi64(v, t0), _mm_unpacklo_epi64(t1, t2),
+              mask & 0xFF, dst);
+  expandGroup(_mm_unpackhi_epi64(v, t0), _mm_unpackhi_epi64(t1, t2),
+              (mask >> 8) & 0xFF, dst);
+}
+
+// Expands whole 16-byte blocks of `input` into `dst` and returns the number
+// of input bytes consumed. Digit-free blocks are copied with a single store.
+// Stores may run past the bytes produced but never past `dstEnd`; the kernel
+// stops early when a block might not fit and leaves the rest to the caller.
+__attribute__((target("sse4.2"))) size_t
+expandBlocksSse42(std::string_view input, char *&dst, const char *dstEnd,
+                  const ExpansionTable &table) {
+  constexpr size_t kBlockFootprint = 24 + kGroupFootprint;
+  const __m128i first = loadControl(table.lanes[0]);
+  const __m128i second = loadControl(table.lanes[1]);
+  const __m128i third = loadControl(table.lanes[2]);
+  const __m128i belowZero = _mm_set1_epi8('0' - 1);
+  const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+  const __m128i zero = _mm_set1_epi8('0');
+
+  size_t i = 0;
+  for (; i + 16 <= input.size() &&
+         static_cast<size_t>(dstEnd - dst) >= kBlockFootprint;
+       i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + i));
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(v, belowZero),
+                                    _mm_cmpgt_epi8(aboveNine, v));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(isDigit));
+    if (mask == 0) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), v);
+      dst += 16;
+      continue;
+    }
+    __m128i d = _mm_sub_epi8(v, zero);
+    expandBlock16(v, _mm_shuffle_epi8(first, d), _mm_shuffle_epi8(second, d),
+                  _mm_shuffle_epi8(third, d), mask, dst);
+  }
+  return i;
+}
+
+// Same contract as expandBlocksSse42() with 32-byte blocks.
+__attribute__((target("avx2"))) size_t
+expandBlocksAvx2(std::string_view input, char *&dst, const char *dstEnd,
+                 const ExpansionTable &table) {
+  // Three groups of 24 bytes followed by the full footprint of the fourth
+  constexpr size_t kBlockFootprint = 3 * 24 + kGroupFootprint;
+  const __m256i first = _mm256_broadcastsi128_si256(loadControl(table.lanes[0]));
+  const __m256i second =
+      _mm256_broadcastsi128_si256(loadControl(table.lanes[1]));
+  const __m256i third = _mm256_broadcastsi128_si256(loadControl(table.lanes[2]));
+  const __m256i belowZero = _mm256_set1_epi8('0' - 1);
+  const __m256i aboveNine = _mm256_set1_epi8('9' + 1);
+  const __m256i zero = _mm256_set1_epi8('0');
+
+  size_t i = 0;
+  for (; i + 32 <= input.size() &&
+         static_cast<size_t>(dstEnd - dst) >= kBlockFootprint;
+       i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input.data() + i));
+    __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(v, belowZero),
+                                       _mm256_cmpgt_epi8(aboveNine, v));
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(isDigit));
+    if (mask == 0) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), v);
+      dst += 32;
+      continue;
+    }
+
+    __m256i d = _mm256_sub_epi8(v, zero);
+    __m256i t0 = _mm256_shuffle_epi8(first, d);
+    __m256i t1 = _mm256_shuffle_epi8(second, d);
+    __m256i t2 = _mm256_shuffle_epi8(third, d);
+    expandBlock16(_mm256_castsi256_si128(v), _mm256_castsi256_si128(t0),
+                  _mm256_castsi256_si128(t1), _mm256_castsi256_si128(t2),
+                  mask & 0xFFFF, dst);
+    expandBlock16(_mm256_extracti128_si256(v, 1),
+                  _mm256_extracti128_si256(t0, 1),
+                  _mm256_extracti128_si256(t1, 1),
+                  _mm256_extracti128_si256(t2, 1), mask >> 16, dst);
+  }
+  return i;
+}
+
+// --- AVX-512 VBMI Forward Expansion ---
+// Input byte i of a 64-byte block owns slots 3i..3i+2 of a 192-byte sparse
+// layout: the byte itself (or its replacement's first byte), then the
+// replacement's second and third bytes. Interleaving three 64-byte vectors
+// into that layout is a fixed byte permutation; compressing away the two
+// unused slots of every non-digit leaves exactly the output. The work per
+// block is the same at any digit density.
+struct SparseLayout {
+  // Per output vector: vpermt2b indices over (first, second) and vpermb
+  // indices into third, which fills the slots in thirdSlots
+  std::array<std::array<uint8_t, 64>, 3> pairIndex, thirdIndex;
+  std::array<uint64_t, 3> thirdSlots;
+  // Slots that are always used, and where the per-digit second and third
+  // slots of each output vector lie: digit bits from secondStart (or
+  // thirdStart) on are deposited into secondMask (or thirdMask) with pdep
+  std::array<uint64_t, 3> leadMask, secondMask, thirdMask;
+  std::array<unsigned, 3> secondStart, thirdStart;
+};
+
+constexpr SparseLayout makeSparseLayout() {
+  SparseLayout layout{};
+  for (unsigned c = 0; c < 3; ++c) {
+    layout.secondStart[c] = layout.thirdStart[c] = 64;
+    for (unsigned j = 0; j < 64; ++j) {
+      unsigned slot = 64 * c + j;
+      unsigned i = slot / 3;
+      uint64_t bit = uint64_t{1} << j;
+      layout.thirdIndex[c][j] = static_cast<uint8_t>(i);
+      switch (slot % 3) {
+      case 0:
+        layout.pairIndex[c][j] = static_cast<uint8_t>(i);
+        layout.leadMask[c] |= bit;
+        break;
+      case 1:
+        layout.pairIndex[c][j] = static_cast<uint8_t>(64 + i);
+        layout.secondMask[c] |= bit;
+        layout.secondStart[c] = std::min(layout.secondStart[c], i);
+        break;
+      default:
+        layout.thirdSlots[c] |= bit;
+        layout.thirdMask[c] |= bit;
+        layout.thirdStart[c] = std::min(layout.thirdStart[c], i);
+        break;
+      }
+    }
+  }
+  return layout;
+}
+
+constexpr SparseLayout kSparseLayout = makeSparseLayout();
+
+#define ZENKAKU_AVX512_TARGET                                                  \
+  __attribute__((target("avx512f,avx512bw,avx512vbmi,avx512vbmi2,bmi2")))
+
+// `control` in all four 128-bit lanes. The all-lanes mask form starts from
+// a zeroed vector, where _mm512_broadcast_i32x4() starts from an undefined
+// one that GCC 12 reports as used uninitialized; both are one vbroadcast.
+ZENKAKU_AVX512_TARGET __m512i
+broadcastControl(const std::array<uint8_t, 16> &control) {
+  return _mm512_maskz_broadcast_i32x4(0xFFFF, loadControl(control));
+}
+
+// Same contract as expandBlocksSse42() with 64-byte blocks.
+ZENKAKU_AVX512_TARGET size_t
+expandBlocksAvx512(std::string_view input, char *&dst, const char *dstEnd,
+                   const ExpansionTable &table) {
+  // Three compressed stores of 64 bytes, the last at offset 128 at most
+  constexpr size_t kBlockFootprint = 3 * 64;
+  const __m512i first = broadcastControl(table.lanes[0]);
+  const __m512i second = broadcastControl(table.lanes[1]);
+  const __m512i third = broadcastControl(table.lanes[2]);
+  const __m512i zero = _mm512_set1_epi8('0');
+  const __m512i ten = _mm512_set1_epi8(10);
+  const SparseLayout &layout = kSparseLayout;
+
+  size_t i = 0;
+  for (; i + 64 <= input.size() &&
+         static_cast<size_t>(dstEnd - dst) >= kBlockFootprint;
+       i += 64) {
+    __m512i v = _mm512_loadu_si512(input.data() + i);
+    __m512i d = _mm512_sub_epi8(v, zero);
+    __mmask64 digits = _mm512_cmplt_epu8_mask(d, ten);
+    if (digits == 0) {
+      _mm512_storeu_si512(dst, v);
+      dst += 64;
+      continue;
+    }
+
+    __m512i b0 = _mm512_mask_shuffle_epi8(v, digits, first, d);
+    __m512i b1 = _mm512_shuffle_epi8(second, d);
+    __m512i b2 = _mm512_shuffle_epi8(third, d);
+    for (int c = 0; c < 3; ++c) {
+      __m512i sparse = _mm512_permutex2var_epi8(
+          b0, _mm512_loadu_si512(layout.pairIndex[c].data()), b1);
+      sparse = _mm512_mask_permutexvar_epi8(
+          sparse, layout.thirdSlots[c],
+          _mm512_loadu_si512(layout.thirdIndex[c].data()), b2);
+      uint64_t used =
+          layout.leadMask[c] |
+          _pdep_u64(digits >> layout.secondStart[c], layout.secondMask[c]) |
+          _pdep_u64(digits >> layout.thirdStart[c], layout.thirdMask[c]);
+      _mm512_storeu_si512(dst, _mm512_maskz_compress_epi8(used, sparse));
+      dst += std::popcount(used);
+    }
+  }
+  return i;
+}
+
+template <size_t (*Blocks)(std::string_view, char *&, const char *,
+                           const ExpansionTable &)>
+char *expandWith(std::string_view input, char *dst, const char *dstEnd,
+                 const ExpansionTable &table) {
+  input.remove_prefix(Blocks(input, dst, dstEnd, table));
+  return expandDigitsScalar(input, dst, table.utf8);
+}
+
+// --- Digit Scanner ---
+// pcmpestri in range mode finds the first byte in '0'..'9' of each 16-byte
+// block directly, without a separate mask-and-count step.
+__attribute__((target("sse4.2"))) size_t findDigitSse42(std::string_view input,
+                                                        size_t from) {
+  const __m128i range = _mm_setr_epi8('0', '9', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                      0, 0, 0, 0);
+  size_t i = from;
+  for (; i + 16 <= input.size(); i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + i));
+    int index = _mm_cmpestri(range, 2, v, 16,
+                             _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                                 _SIDD_LEAST_SIGNIFICANT);
+    if (index < 16)
+      return i + static_cast<size_t>(index);
+  }
+  return findDigitScalar(input, i);
+}
+
+__attribute__((target("avx2"))) size_t findDigitAvx2(std::string_view input,
+                                                     size_t from) {
+  const __m256i belowZero = _mm256_set1_epi8('0' - 1);
+  const __m256i aboveNine = _mm256_set1_epi8('9' + 1);
+  size_t i = from;
+  for (; i + 32 <= input.size(); i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input.data() + i));
+    __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(v, belowZero),
+                                       _mm256_cmpgt_epi8(aboveNine, v));
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(isDigit));
+    if (mask != 0)
+      return i + static_cast<size_t>(std::countr_zero(mask));
+  }
+  return findDigitScalar(input, i);
+}
+
+// --- Lead-Byte Scanner ---
+// The high nibble must be 0xE and the low nibble is looked up in a 16-entry
+// pshufb table built from `leads`.
+__attribute__((target("sse4.2"))) __m128i nibbleTable(LeadByteSet leads) {
+  alignas(16) uint8_t nibbles[16];
+  for (size_t n = 0; n < 16; ++n) {
+    nibbles[n] = ((leads >> n) & 1) ? 0xFF : 0x00;
+  }
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(nibbles));
+}
+
+// Bit k is set if byte k of `v` is a lead byte whose low nibble `table`
+// marks.
+__attribute__((target("sse4.2"))) inline unsigned leadMask(__m128i v,
+                                                          __m128i table) {
+  const __m128i highNibble = _mm_set1_epi8(static_cast<char>(0xF0));
+  const __m128i lowNibble = _mm_set1_epi8(0x0F);
+  const __m128i threeByteLead = _mm_set1_epi8(static_cast<char>(0xE0));
+  __m128i isLead = _mm_cmpeq_epi8(_mm_and_si128(v, highNibble), threeByteLead);
+  __m128i inSet = _mm_shuffle_epi8(table, _mm_and_si128(v, lowNibble));
+  return static_cast<unsigned>(
+      _mm_movemask_epi8(_mm_and_si128(isLead, inSet)));
+}
+
+__attribute__((target("avx2"))) inline uint32_t leadMask(__m256i v,
+                                                        __m256i table) {
+  const __m256i highNibble = _mm256_set1_epi8(static_cast<char>(0xF0));
+  const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+  const __m256i threeByteLead = _mm256_set1_epi8(static_cast<char>(0xE0));
+  __m256i isLead =
+      _mm256_cmpeq_epi8(_mm256_and_si256(v, highNibble), threeByteLead);
+  __m256i inSet = _mm256_shuffle_epi8(table, _mm256_and_si256(v, lowNibble));
+  return static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_and_si256(isLead, inSet)));
+}
+
+__attribute__((target("sse4.2"))) size_t
+findLeadByteSse42(std::string_view input, size_t from, LeadByteSet leads) {
+  const __m128i table = nibbleTable(leads);
+  size_t i = from;
+  for (; i + 16 <= input.size(); i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + i));
+    if (unsigned mask = leadMask(v, table))
+      return i + static_cast<size_t>(std::countr_zero(mask));
+  }
+  return findLeadByteScalar(input, i, leads);
+}
+
+__attribute__((target("avx2"))) size_t
+findLeadByteAvx2(std::string_view input, size_t from, LeadByteSet leads) {
+  const __m256i table = _mm256_broadcastsi128_si256(nibbleTable(leads));
+  size_t i = from;
+  for (; i + 32 <= input.size(); i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input.data() + i));
+    if (uint32_t mask = leadMask(v, table))
+      return i + static_cast<size_t>(std::countr_zero(mask));
+  }
+  return findLeadByteScalar(input, i, leads);
+}
+
+// --- Counting Passes ---
+// requiredSize() runs these before any output exists, so they only load:
+// one compare and a popcount of the byte mask per block.
+__attribute__((target("sse4.2"))) size_t
+countDigitsSse42(std::string_view input) {
+  const __m128i belowZero = _mm_set1_epi8('0' - 1);
+  const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 16 <= input.size(); i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + i));
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(v, belowZero),
+                                    _mm_cmpgt_epi8(aboveNine, v));
+    count += static_cast<size_t>(
+        std::popcount(static_cast<unsigned>(_mm_movemask_epi8(isDigit))));
+  }
+  return count + countDigitsScalar(input.substr(i));
+}
+
+// Bit k is set if byte k of the 32 at `p` is an ASCII digit.
+__attribute__((target("avx2"))) inline uint32_t digitMask(const char *p) {
+  const __m256i belowZero = _mm256_set1_epi8('0' - 1);
+  const __m256i aboveNine = _mm256_set1_epi8('9' + 1);
+  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(v, belowZero),
+                                     _mm256_cmpgt_epi8(aboveNine, v));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(isDigit));
+}
+
+// Two vectors per iteration, so there is one popcount per 64 bytes
+__attribute__((target("avx2"))) size_t
+countDigitsAvx2(std::string_view input) {
+  const char *src = input.data();
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 64 <= input.size(); i += 64) {
+    uint64_t mask =
+        digitMask(src + i) | uint64_t{digitMask(src + i + 32)} << 32;
+    count += static_cast<size_t>(std::popcount(mask));
+  }
+  return count + countDigitsSse42(input.substr(i));
+}
+
+// Tries each lead byte in `mask`, a block starting at `block`, against
+// `trie`. See countSequencesWith() for why candidates are independent.
+inline size_t countMatches(std::string_view input, size_t block,
+                           uint64_t mask, const DigitTrie &trie) {
+  size_t count = 0;
+  for (; mask != 0; mask &= mask - 1) {
+    size_t at = block + static_cast<size_t>(std::countr_zero(mask));
+    if (at + 2 < input.size() &&
+        trie.match(reinterpret_cast<const unsigned char *>(input.data() + at)))
+      ++count;
+  }
+  return count;
+}
+
+__attribute__((target("sse4.2"))) size_t
+countSequencesSse42(std::string_view input, const DigitTrie &trie) {
+  const __m128i table = nibbleTable(trie.leadBytes());
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 16 <= input.size(); i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input.data() + i));
+    if (unsigned mask = leadMask(v, table))
+      count += countMatches(input, i, mask, trie);
+  }
+  return count +
+         countSequencesWith<findLeadByteScalar>(input.substr(i), trie);
+}
+
+__attribute__((target("avx2"))) size_t
+countSequencesAvx2(std::string_view input, const DigitTrie &trie) {
+  const __m256i table =
+      _mm256_broadcastsi128_si256(nibbleTable(trie.leadBytes()));
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 32 <= input.size(); i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input.data() + i));
+    if (uint32_t mask = leadMask(v, table))
+      count += countMatches(input, i, mask, trie);
+  }
+  return count + countSequencesSse42(input.substr(i), trie);
+}
+
+} // namespace
+
+const KernelSet kSse42Kernels{Kernel::Sse42,
+                              expandWith<expandBlocksSse42>,
+                              findDigitSse42,
+                              findLeadByteSse42,
+                              reverseDigitsWith<findLeadByteSse42>,
+                              countDigitsSse42,
+                              countSequencesSse42};
+
+const KernelSet kAvx2Kernels{Kernel::Avx2,
+                             expandWith<expandBlocksAvx2>,
+                             findDigitAvx2,
+                             findLeadByteAvx2,
+                             reverseDigitsWith<findLeadByteAvx2>,
+                             countDigitsAvx2,
+                             countSequencesAvx2};
+
+// Scans and counts are memory-bound at 32 bytes per step already; only
+// expansion gains from the wider kernel
+const KernelSet kAvx512Kernels{Kernel::Avx512,
+                               expandWith<expandBlocksAvx512>,
+                               findDigitAvx2,
+                               findLeadByteAvx2,
+                               reverseDigitsWith<findLeadByteAvx2>,
+                               countDigitsAvx2,
+                               countSequencesAvx2};
+
+} // namespace zenkaku
+#endif
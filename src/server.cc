@@ -0,0 +1,415 @@
+#include <zenkaku/server.hpp>
+#include <zenkaku/stats.hpp>
+#include <zenkaku/stream.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace zenkaku {
+namespace {
+
+// Set by ConversionServer::stop(); the eventfd wakes a blocked epoll_wait()
+volatile sig_atomic_t stopRequested = 0;
+int wakeFd = -1;
+
+constexpr size_t kReadSize = 64 << 10;
+// Stop reading from a client whose unread responses exceed this
+constexpr size_t kMaxBacklog = 4 * kMaxRequestPayload;
+
+void putU32(char *p, uint32_t value) {
+  p[0] = static_cast<char>(value >> 24);
+  p[1] = static_cast<char>(value >> 16);
+  p[2] = static_cast<char>(value >> 8);
+  p[3] = static_cast<char>(value);
+}
+
+uint32_t getU32(const char *p) {
+  auto byte = [p](int i) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(p[i]));
+  };
+  return byte(0) << 24 | byte(1) << 16 | byte(2) << 8 | byte(3);
+}
+
+// Appends a response frame whose body is `body`.
+void appendResponse(std::string &out, ResponseStatus status,
+                    std::string_view body) {
+  char header[kResponseHeaderSize];
+  header[0] = static_cast<char>(status);
+  putU32(header + 1, static_cast<uint32_t>(body.size()));
+  out.append(header, sizeof(header));
+  out.append(body);
+}
+
+// Fills `addr` for `path`. Returns false with errno set if it does not fit.
+bool socketAddress(const std::string &path, sockaddr_un &addr) {
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  std::memcpy(addr.sun_path, path.data(), path.size());
+  return true;
+}
+
+// Removes a socket file left at `path` by a server that is no longer
+// running, so bind() can reuse the path. Anything else there is kept:
+// returns false with errno EEXIST for a file that is not a socket and
+// EADDRINUSE for a socket a live server still accepts on.
+bool removeStaleSocket(const std::string &path, const sockaddr_un &addr) {
+  struct stat st;
+  if (::lstat(path.c_str(), &st) != 0)
+    return errno == ENOENT;
+  if (!S_ISSOCK(st.st_mode)) {
+    errno = EEXIST;
+    return false;
+  }
+  int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probe < 0)
+    return false;
+  int result = ::connect(probe, reinterpret_cast<const sockaddr *>(&addr),
+                         sizeof(addr));
+  int error = errno;
+  ::close(probe);
+  if (result == 0) {
+    errno = EADDRINUSE;
+    return false;
+  }
+  // Only a refused connection shows nobody is listening
+  if (error != ECONNREFUSED) {
+    errno = error;
+    return false;
+  }
+  return ::unlink(path.c_str()) == 0 || errno == ENOENT;
+}
+
+// Sends every byte of `iov`, like writeAllv(), but with MSG_NOSIGNAL so a
+// server that goes away fails with EPIPE instead of raising SIGPIPE.
+bool sendAllv(int fd, iovec *iov, size_t count) {
+  while (count > 0) {
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+    ssize_t n = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    auto sent = static_cast<size_t>(n);
+    while (count > 0 && sent >= iov->iov_len) {
+      sent -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+      iov->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+// Reads exactly `size` bytes. Returns false with errno set on error, or with
+// errno == ECONNRESET if the peer closes first.
+bool readExact(int fd, char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::read(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (n == 0) {
+      errno = ECONNRESET;
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+} // namespace
+
+// --- Conversion Server ---
+ConversionServer::~ConversionServer() {
+  for (auto &[fd, connection] : connections) {
+    ::close(fd);
+  }
+  if (listenFd >= 0) {
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+  }
+  if (epollFd >= 0)
+    ::close(epollFd);
+  if (eventFd >= 0) {
+    ::close(eventFd);
+    if (wakeFd == eventFd)
+      wakeFd = -1;
+  }
+}
+
+bool ConversionServer::listen(const std::string &path) {
+  sockaddr_un addr;
+  if (!socketAddress(path, addr))
+    return false;
+
+  // A socket file left behind by a previous server would make bind() fail
+  if (!removeStaleSocket(path, addr))
+    return false;
+  listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd < 0)
+    return false;
+  if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+    return false;
+  socketPath = path;
+  if (::listen(listenFd, SOMAXCONN) != 0)
+    return false;
+
+  epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0)
+    return false;
+  eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (eventFd < 0)
+    return false;
+  wakeFd = eventFd;
+  for (int fd : {listenFd, eventFd}) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool ConversionServer::run() {
+  epoll_event events[64];
+  while (!stopRequested) {
+    int n = ::epoll_wait(epollFd, events, 64, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == listenFd) {
+        accept();
+      } else if (fd != eventFd) {
+        auto it = connections.find(fd);
+        if (it != connections.end() &&
+            !service(fd, it->second, events[i].events))
+          close(fd);
+      }
+    }
+  }
+  return true;
+}
+
+void ConversionServer::stop() {
+  stopRequested = 1;
+  if (wakeFd >= 0) {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wakeFd, &one, sizeof(one));
+  }
+}
+
+void ConversionServer::accept() {
+  while (true) {
+    int fd = ::accept4(listenFd, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return; // EAGAIN once drained; other errors drop just this client
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ::close(fd);
+      continue;
+    }
+    connections.emplace(fd, Connection{});
+  }
+}
+
+bool ConversionServer::service(int fd, Connection &connection,
+                               uint32_t events) {
+  if (events & EPOLLERR)
+    return false;
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+    while (!connection.closing) {
+      size_t filled = connection.input.size();
+      connection.input.resize(filled + kReadSize);
+      ssize_t n;
+      {
+        PhaseTimer timer(Phase::Read);
+        n = ::read(fd, connection.input.data() + filled, kReadSize);
+      }
+      connection.input.resize(filled +
+                              static_cast<size_t>(std::max<ssize_t>(n, 0)));
+      if (n > 0)
+        continue;
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+      // End of input: answer what arrived, then close once it is written
+      connection.closing = n == 0;
+      break;
+    }
+    dispatch(connection);
+  }
+  if (!flush(fd, connection))
+    return false;
+  if (connection.closing && connection.output.empty())
+    return false;
+  watch(fd, connection);
+  return true;
+}
+
+// Answers every complete request in the connection's input buffer.
+void ConversionServer::dispatch(Connection &connection) {
+  std::string_view input = connection.input;
+  size_t consumed = 0;
+  while (input.size() - consumed >= kRequestHeaderSize) {
+    const char *header = input.data() + consumed;
+    auto direction = static_cast<uint8_t>(header[0]);
+    size_t typeLength = static_cast<uint8_t>(header[1]);
+    size_t payloadLength = getU32(header + 2);
+    if (direction > 1 || payloadLength > kMaxRequestPayload) {
+      // The stream cannot be resynchronised after a malformed header
+      appendResponse(connection.output, ResponseStatus::BadRequest,
+                     direction > 1 ? "invalid direction" : "payload too large");
+      connection.closing = true;
+      consumed = input.size();
+      break;
+    }
+    size_t frameSize = kRequestHeaderSize + typeLength + payloadLength;
+    if (input.size() - consumed < frameSize)
+      break;
+
+    std::string_view type =
+        input.substr(consumed + kRequestHeaderSize, typeLength);
+    std::string_view payload =
+        input.substr(consumed + kRequestHeaderSize + typeLength, payloadLength);
+    consumed += frameSize;
+
+    bool reverse = direction == static_cast<uint8_t>(RequestDirection::Reverse);
+    const DigitConverter *converter = findConverter(type);
+    if (!converter) {
+      appendResponse(connection.output, ResponseStatus::UnknownType,
+                     "unknown conversion type '" + std::string(type) + "'");
+    } else if (type == "any" && !reverse) {
+      appendResponse(connection.output, ResponseStatus::BadRequest,
+                     "conversion type 'any' requires reverse");
+    } else {
+      // Convert straight into the output buffer, then patch the length in
+      std::string &out = connection.output;
+      size_t start = out.size();
+      appendResponse(out, ResponseStatus::Ok, {});
+      {
+        PhaseTimer timer(Phase::Convert);
+        convertText(*converter, reverse, payload, out);
+      }
+      size_t produced = out.size() - start - kResponseHeaderSize;
+      recordConversion(*converter, reverse, payload, produced);
+      putU32(out.data() + start + 1, static_cast<uint32_t>(produced));
+    }
+  }
+  connection.input.erase(0, consumed);
+}
+
+// Writes as much pending output as the socket takes without blocking.
+bool ConversionServer::flush(int fd, Connection &connection) {
+  std::string &out = connection.output;
+  PhaseTimer timer(Phase::Write);
+  while (connection.written < out.size()) {
+    ssize_t n = ::send(fd, out.data() + connection.written,
+                       out.size() - connection.written, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      return false;
+    }
+    connection.written += static_cast<size_t>(n);
+  }
+  out.clear();
+  connection.written = 0;
+  return true;
+}
+
+// Waits for input unless the client is closing or too far behind on reading
+// its responses, and for writability while output is pending.
+void ConversionServer::watch(int fd, const Connection &connection) {
+  size_t backlog = connection.output.size() - connection.written;
+  epoll_event event{};
+  event.data.fd = fd;
+  if (!connection.closing && backlog < kMaxBacklog)
+    event.events |= EPOLLIN | EPOLLRDHUP;
+  if (backlog > 0)
+    event.events |= EPOLLOUT;
+  ::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void ConversionServer::close(int fd) {
+  ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  ::close(fd);
+  connections.erase(fd);
+}
+
+// --- Conversion Client ---
+ConversionClient::~ConversionClient() {
+  if (fd >= 0)
+    ::close(fd);
+}
+
+bool ConversionClient::connect(const std::string &path) {
+  sockaddr_un addr;
+  if (!socketAddress(path, addr))
+    return false;
+  fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return false;
+  return ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+}
+
+bool ConversionClient::request(std::string_view type,
+                               RequestDirection direction,
+                               std::string_view payload, Response &response) {
+  if (type.size() > UINT8_MAX || payload.size() > kMaxRequestPayload) {
+    errno = EMSGSIZE;
+    return false;
+  }
+  char header[kRequestHeaderSize];
+  header[0] = static_cast<char>(direction);
+  header[1] = static_cast<char>(type.size());
+  putU32(header + 2, static_cast<uint32_t>(payload.size()));
+  iovec iov[] = {
+      {header, sizeof(header)},
+      {const_cast<char *>(type.data()), type.size()},
+      {const_cast<char *>(payload.data()), payload.size()},
+  };
+  if (!sendAllv(fd, iov, 3))
+    return false;
+
+  char reply[kResponseHeaderSize];
+  if (!readExact(fd, reply, sizeof(reply)))
+    return false;
+  response.status = static_cast<ResponseStatus>(reply[0]);
+  response.body.resize(getU32(reply + 1));
+  return readExact(fd, response.body.data(), response.body.size());
+}
+
+} // namespace zenkaku
@@ -0,0 +1,146 @@
+#include <zenkaku/stats.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+namespace zenkaku {
+namespace {
+
+// Threads past kMaxThreads share the last block; the adds are atomic, so
+// the totals stay exact, only the sharing threads contend.
+constexpr size_t kMaxThreads = 256;
+// Everything the registry holds plus the any-script converter; a converter
+// past this is only counted in the total.
+constexpr size_t kMaxConverters = ConverterRegistry::kMaxConverters + 1;
+
+struct alignas(64) ThreadStats {
+  std::atomic<uint64_t> bytesIn{0};
+  std::atomic<uint64_t> bytesOut{0};
+  std::atomic<uint64_t> lines{0};
+  std::atomic<uint64_t> sequences{0};
+  std::array<std::atomic<int64_t>, 3> nanos{};
+  std::array<std::atomic<const DigitConverter *>, kMaxConverters> converters{};
+  std::array<std::atomic<uint64_t>, kMaxConverters> converterSequences{};
+};
+
+// Static storage, so claiming a block never allocates
+ThreadStats blocks[kMaxThreads];
+std::atomic<size_t> claimed{0};
+std::atomic<bool> recording{false};
+thread_local ThreadStats *own = nullptr;
+
+ThreadStats &threadStats() {
+  if (!own) {
+    size_t k = claimed.fetch_add(1, std::memory_order_relaxed);
+    own = &blocks[std::min(k, kMaxThreads - 1)];
+  }
+  return *own;
+}
+
+void add(std::atomic<uint64_t> &counter, uint64_t n) {
+  counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t countLines(std::string_view input) {
+  uint64_t lines = 0;
+  const char *p = input.data();
+  const char *end = p + input.size();
+  while ((p = static_cast<const char *>(std::memchr(p, '\n', end - p)))) {
+    ++lines;
+    ++p;
+  }
+  return lines;
+}
+
+// Finds or claims the slot counting `converter` in `stats`.
+std::atomic<uint64_t> *converterSlot(ThreadStats &stats,
+                                     const DigitConverter &converter) {
+  for (size_t k = 0; k < kMaxConverters; ++k) {
+    const DigitConverter *current =
+        stats.converters[k].load(std::memory_order_acquire);
+    if (!current &&
+        stats.converters[k].compare_exchange_strong(
+            current, &converter, std::memory_order_acq_rel))
+      return &stats.converterSequences[k];
+    if (current == &converter)
+      return &stats.converterSequences[k];
+  }
+  return nullptr;
+}
+
+} // namespace
+
+void enableStats(bool enabled) {
+  recording.store(enabled, std::memory_order_relaxed);
+}
+
+bool statsEnabled() { return recording.load(std::memory_order_relaxed); }
+
+void recordConversion(const DigitConverter &converter, bool reverse,
+                      std::string_view input, size_t outputSize) {
+  if (!statsEnabled())
+    return;
+  ThreadStats &stats = threadStats();
+  add(stats.bytesIn, input.size());
+  add(stats.bytesOut, outputSize);
+  add(stats.lines, countLines(input));
+  uint64_t sequences =
+      (reverse ? input.size() - outputSize : outputSize - input.size()) / 2;
+  if (sequences == 0)
+    return;
+  add(stats.sequences, sequences);
+  if (std::atomic<uint64_t> *slot = converterSlot(stats, converter))
+    add(*slot, sequences);
+}
+
+void recordTime(Phase phase, std::chrono::nanoseconds elapsed) {
+  if (!statsEnabled())
+    return;
+  threadStats()
+      .nanos[static_cast<size_t>(phase)]
+      .fetch_add(elapsed.count(), std::memory_order_relaxed);
+}
+
+Stats collectStats() {
+  Stats total;
+  size_t used = std::min(claimed.load(std::memory_order_relaxed), kMaxThreads);
+  for (size_t t = 0; t < used; ++t) {
+    const ThreadStats &stats = blocks[t];
+    total.bytesIn += stats.bytesIn.load(std::memory_order_relaxed);
+    total.bytesOut += stats.bytesOut.load(std::memory_order_relaxed);
+    total.lines += stats.lines.load(std::memory_order_relaxed);
+    total.sequences += stats.sequences.load(std::memory_order_relaxed);
+    total.readTime += std::chrono::nanoseconds(
+        stats.nanos[static_cast<size_t>(Phase::Read)].load(
+            std::memory_order_relaxed));
+    total.convertTime += std::chrono::nanoseconds(
+        stats.nanos[static_cast<size_t>(Phase::Convert)].load(
+            std::memory_order_relaxed));
+    total.writeTime += std::chrono::nanoseconds(
+        stats.nanos[static_cast<size_t>(Phase::Write)].load(
+            std::memory_order_relaxed));
+
+    for (size_t k = 0; k < kMaxConverters; ++k) {
+      const DigitConverter *converter =
+          stats.converters[k].load(std::memory_order_acquire);
+      if (!converter)
+        break;
+      uint64_t sequences =
+          stats.converterSequences[k].load(std::memory_order_relaxed);
+      std::string name = converter->getName();
+      auto it = std::find_if(
+          total.sequencesByConverter.begin(), total.sequencesByConverter.end(),
+          [&name](const auto &entry) { return entry.first == name; });
+      if (it == total.sequencesByConverter.end()) {
+        total.sequencesByConverter.emplace_back(std::move(name), sequences);
+      } else {
+        it->second += sequences;
+      }
+    }
+  }
+  return total;
+}
+
+} // namespace zenkaku
@@ -0,0 +1,622 @@
+#include "converters.hpp"
+
+#include <zenkaku/debug.hpp>
+#include <zenkaku/stats.hpp>
+#include <zenkaku/stream.hpp>
+#include <zenkaku/utf8.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <latch>
+#include <numeric>
+#include <span>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zenkaku {
+namespace {
+
+// Reads until `size` bytes are in or input ends. Returns the byte count,
+// which is short only at end of input, or -1 on error.
+ssize_t readFull(int fd, char *data, size_t size) {
+  PhaseTimer timer(Phase::Read);
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = ::read(fd, data + total, size - total);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (n == 0)
+      break;
+    total += static_cast<size_t>(n);
+  }
+  return static_cast<ssize_t>(total);
+}
+
+// Cuts `input` into chunks of about `target` bytes, each ending after a
+// newline, or at a UTF-8 boundary if a line is longer than `target`.
+std::vector<std::string_view> splitLines(std::string_view input,
+                                         size_t target) {
+  std::vector<std::string_view> chunks;
+  while (!input.empty()) {
+    size_t cut = input.size();
+    if (cut > target) {
+      size_t newline = input.rfind('\n', target - 1);
+      cut = newline != std::string_view::npos
+                ? newline + 1
+                : target - incompleteUtf8Tail(input.substr(0, target));
+    }
+    chunks.push_back(input.substr(0, cut));
+    input.remove_prefix(cut);
+  }
+  return chunks;
+}
+
+// convertTextTo() that also counts the conversion in the statistics. The
+// pipeline, parallel and io_uring engines convert whole blocks of up to a
+// few MiB through this, so they keep one virtual call per block rather than
+// resolve the converter through visitConverter().
+size_t convertCounted(const DigitConverter &converter, bool reverse,
+                      std::string_view input, std::span<char> dst) {
+  size_t n;
+  {
+    PhaseTimer timer(Phase::Convert);
+    n = convertTextTo(converter, reverse, input, dst);
+  }
+  recordConversion(converter, reverse, input, n);
+  return n;
+}
+
+// The same for a converter resolved by visitConverter().
+template <typename Directed>
+size_t convertCounted(const Directed &convert, std::string_view input,
+                      std::span<char> dst) {
+  size_t n;
+  {
+    PhaseTimer timer(Phase::Convert);
+    n = convert(input, dst);
+  }
+  recordConversion(convert.converter, Directed::reverse, input, n);
+  return n;
+}
+
+} // namespace
+
+// --- Stream Processing ---
+bool writeAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n = ::write(fd, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+bool writeAllv(int fd, iovec *iov, size_t count) {
+  while (count > 0) {
+    ssize_t n =
+        ::writev(fd, iov, static_cast<int>(std::min<size_t>(count, IOV_MAX)));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    auto written = static_cast<size_t>(n);
+    while (count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+size_t incompleteUtf8Tail(std::string_view data) {
+  size_t limit = std::min<size_t>(data.size(), 4);
+  for (size_t back = 1; back <= limit; ++back) {
+    auto byte = static_cast<unsigned char>(data[data.size() - back]);
+    if ((byte & 0xC0) == 0x80)
+      continue; // continuation byte, keep looking for the lead
+    return back < sequenceLength(byte) ? back : 0;
+  }
+  return 0;
+}
+
+void ScratchBuffer::grow(size_t size) {
+  capacity = std::max(size, 2 * capacity);
+  storage = std::make_unique_for_overwrite<char[]>(capacity);
+}
+
+template <typename Directed>
+bool StreamConverter::runWith(const Directed &convert, int inFd, int outFd) {
+  size_t carry = 0;
+  while (true) {
+    NoAllocationScope scope("StreamConverter::run");
+    ssize_t n;
+    {
+      PhaseTimer timer(Phase::Read);
+      n = ::read(inFd, buffer.data() + carry, kBlockSize);
+    }
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (n == 0) {
+      // A truncated sequence at end of input is passed through unchanged
+      return carry == 0 || flush(convert, {buffer.data(), carry}, outFd);
+    }
+
+    std::string_view block(buffer.data(), carry + static_cast<size_t>(n));
+    carry = incompleteUtf8Tail(block);
+    if (!flush(convert, block.substr(0, block.size() - carry), outFd))
+      return false;
+    std::memmove(buffer.data(), block.data() + block.size() - carry, carry);
+  }
+}
+
+template <typename Directed>
+bool StreamConverter::flush(const Directed &convert, std::string_view block,
+                            int outFd) {
+  std::span<char> dst =
+      out.reserve(maxOutputSize(block.size(), Directed::reverse));
+  size_t n = convertCounted(convert, block, dst);
+  PhaseTimer timer(Phase::Write);
+  return writeAll(outFd, {dst.data(), n});
+}
+
+bool StreamConverter::run(int inFd, int outFd) {
+  return visitConverter(converter, reverseMode, [&](const auto &convert) {
+    return runWith(convert, inFd, outFd);
+  });
+}
+
+// --- Pipelined Conversion ---
+PipelineConverter::PipelineConverter(const DigitConverter &converter,
+                                     bool reverse)
+    : converter(converter), reverseMode(reverse) {
+  for (Block &block : blocks) {
+    block.input.resize(kBlockSize + 4);
+    block.output.reserve(maxOutputSize(kBlockSize + 4, reverse));
+    idle.push(&block);
+  }
+}
+
+bool PipelineConverter::run(int inFd, int outFd) {
+  cancelled.store(false, std::memory_order_relaxed);
+  readErrno = 0;
+  std::thread reader([this, inFd] { read(inFd); });
+  std::thread converterThread([this] { convert(); });
+
+  // Every block comes back to the idle ring, the last one included, so the
+  // rings are ready for another run once this one returns
+  int writeErrno = 0;
+  bool last = false;
+  while (!last) {
+    NoAllocationScope scope("PipelineConverter writer");
+    Block *block = converted.pop();
+    last = block->last;
+    if (writeErrno == 0) {
+      PhaseTimer timer(Phase::Write);
+      if (!writeAll(outFd, {block->output.data(), block->outputSize})) {
+        writeErrno = errno;
+        cancelled.store(true, std::memory_order_relaxed);
+      }
+    }
+    idle.push(block);
+  }
+  reader.join();
+  converterThread.join();
+
+  errno = writeErrno ? writeErrno : readErrno;
+  return errno == 0;
+}
+
+void PipelineConverter::read(int inFd) {
+  char carried[4];
+  size_t carry = 0;
+  while (true) {
+    NoAllocationScope scope("PipelineConverter reader");
+    Block *block = idle.pop();
+    if (cancelled.load(std::memory_order_relaxed)) {
+      block->size = 0;
+      block->last = true;
+      filled.push(block);
+      return;
+    }
+
+    std::memcpy(block->input.data(), carried, carry);
+    ssize_t n;
+    {
+      PhaseTimer timer(Phase::Read);
+      do {
+        n = ::read(inFd, block->input.data() + carry, kBlockSize);
+      } while (n < 0 && errno == EINTR);
+    }
+    if (n <= 0) {
+      // A truncated sequence at end of input is passed through unchanged
+      readErrno = n < 0 ? errno : 0;
+      block->size = n == 0 ? carry : 0;
+      block->last = true;
+      filled.push(block);
+      return;
+    }
+
+    std::string_view data(block->input.data(),
+                          carry + static_cast<size_t>(n));
+    carry = incompleteUtf8Tail(data);
+    std::memcpy(carried, data.data() + data.size() - carry, carry);
+    block->size = data.size() - carry;
+    block->last = false;
+    filled.push(block);
+  }
+}
+
+void PipelineConverter::convert() {
+  bool last = false;
+  while (!last) {
+    NoAllocationScope scope("PipelineConverter converter");
+    Block *block = filled.pop();
+    last = block->last;
+    std::string_view input(block->input.data(), block->size);
+    block->outputSize = convertCounted(
+        converter, reverseMode, input,
+        block->output.reserve(maxOutputSize(input.size(), reverseMode)));
+    converted.push(block);
+  }
+}
+
+// --- Parallel Conversion ---
+void WorkerPool::TaskQueue::push(std::function<void()> task) {
+  if (count == slots.size()) {
+    // Unroll the ring into a twice as large one, oldest task first
+    std::vector<std::function<void()>> grown(std::max<size_t>(2 * count, 1));
+    for (size_t k = 0; k < count; ++k) {
+      grown[k] = std::move(slots[(head + k) % slots.size()]);
+    }
+    slots = std::move(grown);
+    head = 0;
+  }
+  slots[(head + count) % slots.size()] = std::move(task);
+  ++count;
+}
+
+std::function<void()> WorkerPool::TaskQueue::pop() {
+  std::function<void()> task = std::move(slots[head]);
+  slots[head] = nullptr;
+  head = (head + 1) % slots.size();
+  --count;
+  return task;
+}
+
+// Room for the deepest backlog the converters queue: ParallelStreamConverter
+// keeps two chunks per worker in flight, forEach() about four.
+WorkerPool::WorkerPool(size_t threadCount) : tasks(4 * threadCount) {
+  for (size_t i = 0; i < threadCount; ++i) {
+    threads.emplace_back([this] { work(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push(std::move(task));
+  }
+  wake.notify_one();
+}
+
+void WorkerPool::forEach(size_t count,
+                         const std::function<void(size_t)> &task) {
+  // One pointer plus the index, so each submitted closure is stored inline
+  struct Batch {
+    const std::function<void(size_t)> &task;
+    std::latch remaining;
+  } batch{task, std::latch(static_cast<std::ptrdiff_t>(count))};
+  for (size_t k = 0; k < count; ++k) {
+    submit([&batch, k] {
+      batch.task(k);
+      batch.remaining.count_down();
+    });
+  }
+  batch.remaining.wait();
+}
+
+void WorkerPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      task = tasks.pop();
+    }
+    task();
+  }
+}
+
+bool ParallelStreamConverter::run(int inFd, int outFd) {
+  carry.clear();
+  bool eof = false;
+  size_t next = 0;
+  for (; !eof; ++next) {
+    NoAllocationScope scope("ParallelStreamConverter::run");
+    Chunk &chunk = chunks[next % chunks.size()];
+    if (!finish(chunk, outFd))
+      return abandon();
+
+    // Refill with the unfinished line from the previous chunk plus new
+    // input, read straight in without zero-filling the chunk first
+    chunk.input.assign(carry);
+    ssize_t n = 0;
+    chunk.input.resize_and_overwrite(kChunkSize, [&](char *data, size_t) {
+      size_t filled = carry.size();
+      n = readFull(inFd, data + filled, kChunkSize - filled);
+      return filled + static_cast<size_t>(std::max<ssize_t>(n, 0));
+    });
+    if (n < 0)
+      return abandon();
+    size_t filled = chunk.input.size();
+    eof = filled < kChunkSize;
+
+    size_t cut = filled;
+    if (!eof) {
+      size_t newline = chunk.input.rfind('\n');
+      cut = newline != std::string::npos
+                ? newline + 1
+                : filled - incompleteUtf8Tail(chunk.input);
+    }
+    carry.assign(chunk.input, cut);
+    chunk.input.resize(cut);
+    if (chunk.input.empty())
+      continue;
+
+    chunk.pending = true;
+    chunk.done = false;
+    pool.submit([this, &chunk] {
+      {
+        NoAllocationScope scope("ParallelStreamConverter worker");
+        std::span<char> dst = chunk.output.reserve(
+            maxOutputSize(chunk.input.size(), reverseMode));
+        chunk.outputSize =
+            convertCounted(converter, reverseMode, chunk.input, dst);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunk.done = true;
+      }
+      finished.notify_all();
+    });
+  }
+
+  // Flush what is still in flight, oldest first
+  for (size_t k = 0; k < chunks.size(); ++k) {
+    if (!finish(chunks[(next + k) % chunks.size()], outFd))
+      return abandon();
+  }
+  return true;
+}
+
+void ParallelStreamConverter::wait(Chunk &chunk) {
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&chunk] { return chunk.done; });
+}
+
+// Waits for a pending chunk and writes its output.
+bool ParallelStreamConverter::finish(Chunk &chunk, int outFd) {
+  if (!chunk.pending)
+    return true;
+  wait(chunk);
+  chunk.pending = false;
+  PhaseTimer timer(Phase::Write);
+  return writeAll(outFd, {chunk.output.data(), chunk.outputSize});
+}
+
+// Lets in-flight chunks complete before failing, since workers still
+// reference them.
+bool ParallelStreamConverter::abandon() {
+  int savedErrno = errno;
+  for (Chunk &chunk : chunks) {
+    if (chunk.pending)
+      wait(chunk);
+    chunk.pending = false;
+  }
+  errno = savedErrno;
+  return false;
+}
+
+// --- Memory-Mapped Input ---
+MappedInput::~MappedInput() {
+  if (data)
+    ::munmap(data, size);
+}
+
+bool MappedInput::map(int fd) {
+  struct stat info;
+  if (::fstat(fd, &info) != 0)
+    return false;
+  size = static_cast<size_t>(info.st_size);
+  if (size == 0)
+    return true;
+  void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED)
+    return false;
+  data = mapped;
+  ::madvise(data, size, MADV_SEQUENTIAL);
+  return true;
+}
+
+// --- Memory-Mapped File Conversion ---
+bool MappedFileConverter::run(int inFd, int outFd) {
+  MappedInput mapping;
+  if (!mapping.map(inFd))
+    return false;
+  return visitConverter(converter, reverseMode, [&](const auto &convert) {
+    return runWith(convert, mapping.view(), outFd);
+  });
+}
+
+template <typename Directed>
+bool MappedFileConverter::runWith(const Directed &convert,
+                                  std::string_view input, int outFd) {
+  NoAllocationScope scope("MappedFileConverter::run");
+  // Every change is one ASCII digit forward or one 3-byte sequence reverse
+  constexpr size_t changeLength = Directed::reverse ? 3 : 1;
+  size_t region = 0;
+  size_t pos = 0;
+  while (pos < input.size()) {
+    std::string_view rest = input.substr(pos);
+    size_t keep = convert.passthrough(rest);
+    if (keep >= kMinZeroCopy) {
+      if (!convertRegion(convert, input.substr(region, pos - region), outFd))
+        return false;
+      recordConversion(converter, reverseMode, rest.substr(0, keep), keep);
+      if (!emit(input.data() + pos, keep, outFd))
+        return false;
+      region = pos + keep;
+    }
+    pos += keep;
+    if (pos == input.size())
+      break;
+    pos += changeLength;
+    if (pos - region >= kMaxRegion) {
+      if (!convertRegion(convert, input.substr(region, pos - region), outFd))
+        return false;
+      region = pos;
+    }
+  }
+  return convertRegion(convert, input.substr(region), outFd) && flush(outFd);
+}
+
+// Converts `region` into the scratch buffer and queues the result. Any
+// flush happens before converting: flush() reclaims the scratch buffer, so
+// one inside emit() would let the next region overwrite this output before
+// writev() has sent it.
+template <typename Directed>
+bool MappedFileConverter::convertRegion(const Directed &convert,
+                                        std::string_view region, int outFd) {
+  if (region.empty())
+    return true;
+  std::span<char> space = scratch.reserve(kScratchSize);
+  if ((pending.size() == IOV_MAX ||
+       space.size() - used < maxOutputSize(region.size(), Directed::reverse)) &&
+      !flush(outFd))
+    return false;
+  std::span<char> dst = space.subspan(used);
+  size_t n = convertCounted(convert, region, dst);
+  used += n;
+  return emit(dst.data(), n, outFd);
+}
+
+bool MappedFileConverter::emit(const char *data, size_t size, int outFd) {
+  if (pending.size() == IOV_MAX && !flush(outFd))
+    return false;
+  pending.push_back({const_cast<char *>(data), size});
+  return true;
+}
+
+bool MappedFileConverter::flush(int outFd) {
+  PhaseTimer timer(Phase::Write);
+  bool ok = writeAllv(outFd, pending.data(), pending.size());
+  pending.clear();
+  used = 0;
+  return ok;
+}
+
+// --- Memory-Mapped Parallel Conversion ---
+bool MappedParallelConverter::run(int inFd, int outFd) {
+  MappedInput mapping;
+  if (!mapping.map(inFd))
+    return false;
+  std::string_view input = mapping.view();
+  size_t inSize = input.size();
+  if (inSize == 0)
+    return ::ftruncate(outFd, 0) == 0;
+
+  std::vector<std::string_view> chunks =
+      splitLines(input, std::max(inSize / (4 * jobs), kMinChunkSize));
+
+  // Pass 1: exact output size of every chunk, then offsets by prefix sum
+  std::vector<size_t> offsets(chunks.size() + 1, 0);
+  pool.forEach(chunks.size(), [&](size_t k) {
+    NoAllocationScope scope("MappedParallelConverter sizing");
+    PhaseTimer timer(Phase::Convert);
+    offsets[k + 1] = reverseMode ? converter.reverseSize(chunks[k])
+                                 : converter.convertSize(chunks[k]);
+  });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  size_t outSize = offsets.back();
+
+  if (::ftruncate(outFd, static_cast<off_t>(outSize)) != 0)
+    return false;
+  // A sparse file would report running out of space as SIGBUS in a worker,
+  // so the blocks are reserved before anything is written through the map
+  if (outSize > 0) {
+    int error = ::posix_fallocate(outFd, 0, static_cast<off_t>(outSize));
+    if (error == EOPNOTSUPP || error == EINVAL) {
+      // Nothing can be reserved on this file system: stream instead
+      if (::ftruncate(outFd, 0) != 0 || ::lseek(inFd, 0, SEEK_SET) < 0 ||
+          ::lseek(outFd, 0, SEEK_SET) < 0)
+        return false;
+      ParallelStreamConverter stream(converter, reverseMode, jobs);
+      return stream.run(inFd, outFd);
+    }
+    if (error != 0) {
+      [[maybe_unused]] int truncated = ::ftruncate(outFd, 0);
+      errno = error;
+      return false;
+    }
+  }
+
+  bool ok = true;
+  void *out = MAP_FAILED;
+  if (outSize > 0) {
+    out = ::mmap(nullptr, outSize, PROT_READ | PROT_WRITE, MAP_SHARED, outFd,
+                 0);
+    ok = out != MAP_FAILED;
+  }
+
+  // Pass 2: every chunk is written at its final offset
+  if (ok && outSize > 0) {
+    char *base = static_cast<char *>(out);
+    pool.forEach(chunks.size(), [&](size_t k) {
+      NoAllocationScope scope("MappedParallelConverter worker");
+      std::span<char> dst(base + offsets[k], offsets[k + 1] - offsets[k]);
+      convertCounted(converter, reverseMode, chunks[k], dst);
+    });
+  }
+
+  int savedErrno = errno;
+  if (out != MAP_FAILED)
+    ::munmap(out, outSize);
+  errno = savedErrno;
+  return ok;
+}
+
+} // namespace zenkaku
@@ -0,0 +1,532 @@
+#include <zenkaku/debug.hpp>
+#include <zenkaku/stats.hpp>
+#include <zenkaku/stream.hpp>
+#include <zenkaku/uring.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Raw system calls against the kernel's UAPI header, so there is no
+// liburing dependency. Without the header, supported() is false.
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define ZENKAKU_IO_URING 1
+#include <linux/io_uring.h>
+#endif
+
+namespace zenkaku {
+namespace {
+
+// Bytes kept free in front of each input block for the carried tail of a
+// UTF-8 sequence split at the end of the previous block
+constexpr size_t kHeadRoom = 4;
+constexpr size_t kInputSpan = kHeadRoom + UringConverter::kBlockSize;
+
+// Offset meaning "the file's current position" for stream descriptors
+constexpr uint64_t kCurrentPosition = ~uint64_t{0};
+
+size_t outputSpan(bool reverse) {
+  return maxOutputSize(UringConverter::kBlockSize + kHeadRoom, reverse);
+}
+
+} // namespace
+
+#ifdef ZENKAKU_IO_URING
+namespace {
+
+int setupRing(unsigned entries, io_uring_params &params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int enterRing(int fd, unsigned submit, unsigned wait) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, wait,
+                                    wait > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                    nullptr, 0));
+}
+
+// Submissions the kernel may refuse in a row, with nothing in flight,
+// before UringConverter gives up
+constexpr unsigned kMaxRefusals = 8;
+
+int registerRing(int fd, unsigned opcode, void *arg, unsigned count) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// Ring indices are shared with the kernel
+unsigned loadIndex(unsigned *index) {
+  return std::atomic_ref<unsigned>(*index).load(std::memory_order_acquire);
+}
+
+void storeIndex(unsigned *index, unsigned value) {
+  std::atomic_ref<unsigned>(*index).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+// Submission and completion queues mapped from the kernel. Only the thread
+// running the converter touches them.
+struct UringConverter::Ring {
+  Ring() = default;
+  Ring(const Ring &) = delete;
+  Ring &operator=(const Ring &) = delete;
+  ~Ring();
+
+  // Creates the ring and maps its queues. Returns false with errno set.
+  bool init(unsigned entries);
+
+  // Next free submission entry, zeroed, or nullptr if the queue is full.
+  io_uring_sqe *next();
+
+  // Hands every queued entry to the kernel and waits until at least
+  // `waitFor` completions are available. If the kernel takes no entries
+  // for lack of resources, waits for a completion instead so the caller can
+  // reap it and try again. Returns false with errno set, EAGAIN if the
+  // kernel keeps refusing with nothing in flight to wait for.
+  bool submit(unsigned waitFor);
+
+  // Calls handle(user_data, res) for every available completion.
+  template <typename Handle> void drain(Handle &&handle);
+
+  int fd = -1;
+  void *sqMap = MAP_FAILED;
+  size_t sqMapSize = 0;
+  void *cqMap = MAP_FAILED;
+  size_t cqMapSize = 0;
+  void *sqesMap = MAP_FAILED;
+  size_t sqesSize = 0;
+  unsigned *sqHead = nullptr;
+  unsigned *sqTail = nullptr;
+  unsigned *sqMask = nullptr;
+  unsigned *sqArray = nullptr;
+  unsigned *cqHead = nullptr;
+  unsigned *cqTail = nullptr;
+  unsigned *cqMask = nullptr;
+  io_uring_sqe *sqes = nullptr;
+  io_uring_cqe *cqes = nullptr;
+  // Entries filled in but not yet published, and published but not yet
+  // consumed by the kernel
+  unsigned queued = 0;
+  unsigned pending = 0;
+  // Entries consumed by the kernel whose completions are not yet reaped
+  unsigned inKernel = 0;
+};
+
+UringConverter::Ring::~Ring() {
+  if (sqesMap != MAP_FAILED)
+    ::munmap(sqesMap, sqesSize);
+  if (cqMap != MAP_FAILED && cqMap != sqMap)
+    ::munmap(cqMap, cqMapSize);
+  if (sqMap != MAP_FAILED)
+    ::munmap(sqMap, sqMapSize);
+  if (fd >= 0)
+    ::close(fd);
+}
+
+bool UringConverter::Ring::init(unsigned entries) {
+  io_uring_params params{};
+  fd = setupRing(entries, params);
+  if (fd < 0)
+    return false;
+
+  sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single)
+    sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+  sqMap = ::mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sqMap == MAP_FAILED)
+    return false;
+  cqMap = single ? sqMap
+                 : ::mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  if (cqMap == MAP_FAILED)
+    return false;
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  sqesMap = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqesMap == MAP_FAILED)
+    return false;
+
+  char *sq = static_cast<char *>(sqMap);
+  char *cq = static_cast<char *>(cqMap);
+  sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  sqes = static_cast<io_uring_sqe *>(sqesMap);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  return true;
+}
+
+io_uring_sqe *UringConverter::Ring::next() {
+  // Only this thread moves the tail
+  unsigned tail = *sqTail + queued;
+  if (tail - loadIndex(sqHead) > *sqMask)
+    return nullptr;
+  unsigned index = tail & *sqMask;
+  sqArray[index] = index;
+  ++queued;
+  std::memset(&sqes[index], 0, sizeof(io_uring_sqe));
+  return &sqes[index];
+}
+
+bool UringConverter::Ring::submit(unsigned waitFor) {
+  storeIndex(sqTail, *sqTail + queued);
+  pending += queued;
+  queued = 0;
+  unsigned refused = 0;
+  while (true) {
+    int n = enterRing(fd, pending, waitFor);
+    if (n >= 0) {
+      pending -= static_cast<unsigned>(n);
+      inKernel += static_cast<unsigned>(n);
+      return true;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno != EAGAIN && errno != EBUSY)
+      return false;
+    // Busy or out of resources: completions must be reaped first. Block
+    // for one rather than retry at once, so a full completion queue does
+    // not spin.
+    if (inKernel > 0) {
+      while ((n = enterRing(fd, 0, 1)) < 0 && errno == EINTR) {
+      }
+      return n >= 0;
+    }
+    // Nothing to wait for; give the kernel a few tries, then fail
+    if (++refused == kMaxRefusals) {
+      errno = EAGAIN;
+      return false;
+    }
+  }
+}
+
+template <typename Handle>
+void UringConverter::Ring::drain(Handle &&handle) {
+  unsigned head = *cqHead;
+  unsigned tail = loadIndex(cqTail);
+  for (; head != tail; ++head) {
+    const io_uring_cqe &cqe = cqes[head & *cqMask];
+    handle(cqe.user_data, cqe.res);
+    --inKernel;
+  }
+  storeIndex(cqHead, head);
+}
+
+bool UringConverter::supported() {
+  static const bool probed = [] {
+    Ring ring;
+    if (!ring.init(2))
+      return false;
+    // io_uring_probe ends in a flexible array with one entry per opcode
+    constexpr unsigned kOps = IORING_OP_WRITE + 1;
+    alignas(io_uring_probe) char
+        buffer[sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op)] = {};
+    auto *probe = reinterpret_cast<io_uring_probe *>(buffer);
+    if (registerRing(ring.fd, IORING_REGISTER_PROBE, probe, kOps) < 0)
+      return false;
+    for (unsigned opcode : {IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED,
+                            IORING_OP_READ, IORING_OP_WRITE}) {
+      if (opcode > probe->last_op ||
+          !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+        return false;
+    }
+    return true;
+  }();
+  return probed;
+}
+
+UringConverter::UringConverter(const DigitConverter &converter, bool reverse)
+    : converter(converter), reverseMode(reverse),
+      arena(std::make_unique_for_overwrite<char[]>(
+          kSlots * (kInputSpan + outputSpan(reverse)))) {}
+
+UringConverter::~UringConverter() = default;
+
+char *UringConverter::input(size_t slot) const {
+  return arena.get() + slot * (kInputSpan + outputSpan(reverseMode));
+}
+
+char *UringConverter::output(size_t slot) const {
+  return input(slot) + kInputSpan;
+}
+
+bool UringConverter::run(int inFd, int outFd) {
+  ring = std::make_unique<Ring>();
+  if (!ring->init(2 * kSlots)) {
+    int savedErrno = errno;
+    ring.reset();
+    errno = savedErrno;
+    return false;
+  }
+
+  // Pinning can fail under a low RLIMIT_MEMLOCK; plain reads and writes
+  // then do the same job with a page walk per operation
+  std::array<iovec, 2 * kSlots> buffers;
+  for (size_t k = 0; k < kSlots; ++k) {
+    buffers[2 * k] = {input(k), kInputSpan};
+    buffers[2 * k + 1] = {output(k), outputSpan(reverseMode)};
+  }
+  fixedBuffers = registerRing(ring->fd, IORING_REGISTER_BUFFERS,
+                              buffers.data(), buffers.size()) == 0;
+
+  // Regular files are read and written at explicit offsets, so several
+  // operations can be in flight; O_APPEND ignores offsets and is ordered
+  struct stat info;
+  off_t inStart = -1;
+  if (::fstat(inFd, &info) == 0 && S_ISREG(info.st_mode))
+    inStart = ::lseek(inFd, 0, SEEK_CUR);
+  off_t outStart = -1;
+  int outFlags = ::fcntl(outFd, F_GETFL);
+  if (::fstat(outFd, &info) == 0 && S_ISREG(info.st_mode) && outFlags >= 0 &&
+      !(outFlags & O_APPEND))
+    outStart = ::lseek(outFd, 0, SEEK_CUR);
+
+  this->inFd = inFd;
+  this->outFd = outFd;
+  positionalInput = inStart >= 0;
+  positionalOutput = outStart >= 0;
+  inPosition = positionalInput ? static_cast<uint64_t>(inStart) : 0;
+  outPosition = positionalOutput ? static_cast<uint64_t>(outStart) : 0;
+  slots = {};
+  nextRead = nextConvert = consumed = 0;
+  readEnd = inputDone = false;
+  carry = 0;
+  error = 0;
+
+  while (true) {
+    NoAllocationScope scope("UringConverter::run");
+    if (error == 0) {
+      convertReady();
+      refill();
+    }
+    if (!inFlight())
+      break;
+    if (!ring->submit(1)) {
+      // Closing the ring cancels what is still in flight
+      error = errno;
+      break;
+    }
+    ring->drain([this](uint64_t slot, int result) {
+      complete(static_cast<size_t>(slot), result);
+    });
+  }
+  ring.reset();
+
+  // Leave both file positions where blocking I/O would have
+  if (error == 0 && positionalInput)
+    ::lseek(inFd, inStart + static_cast<off_t>(consumed), SEEK_SET);
+  if (error == 0 && positionalOutput)
+    ::lseek(outFd, static_cast<off_t>(outPosition), SEEK_SET);
+  errno = error;
+  return error == 0;
+}
+
+bool UringConverter::inFlight() const {
+  return std::any_of(slots.begin(), slots.end(), [](const Slot &slot) {
+    return slot.state == Slot::State::Reading ||
+           slot.state == Slot::State::Writing;
+  });
+}
+
+// Starts a read on every idle slot, or on one slot at a time for input
+// without offsets.
+void UringConverter::refill() {
+  for (size_t k = 0; k < kSlots && !readEnd && error == 0; ++k) {
+    Slot &slot = slots[k];
+    if (slot.state != Slot::State::Idle)
+      continue;
+    if (!positionalInput &&
+        std::any_of(slots.begin(), slots.end(), [](const Slot &other) {
+          return other.state == Slot::State::Reading;
+        }))
+      break;
+    slot = Slot{};
+    slot.sequence = nextRead++;
+    if (positionalInput) {
+      slot.inOffset = inPosition;
+      inPosition += kBlockSize;
+    }
+    submitRead(k);
+  }
+}
+
+// Converts read blocks in input order and starts writing their output.
+void UringConverter::convertReady() {
+  while (!inputDone) {
+    auto ready =
+        std::find_if(slots.begin(), slots.end(), [this](const Slot &slot) {
+          return slot.state == Slot::State::Ready &&
+                 slot.sequence == nextConvert;
+        });
+    if (ready == slots.end())
+      break;
+    Slot &slot = *ready;
+    size_t k = static_cast<size_t>(ready - slots.begin());
+    ++nextConvert;
+    consumed += slot.filled;
+
+    char *data = input(k) + kHeadRoom - carry;
+    std::memcpy(data, carried, carry);
+    std::string_view block(data, carry + slot.filled);
+    if (slot.eof) {
+      // A truncated sequence at end of input is passed through unchanged
+      inputDone = true;
+      carry = 0;
+    } else {
+      carry = incompleteUtf8Tail(block);
+      std::memcpy(carried, block.data() + block.size() - carry, carry);
+      block.remove_suffix(carry);
+    }
+
+    {
+      PhaseTimer timer(Phase::Convert);
+      slot.outSize = convertTextTo(converter, reverseMode, block,
+                                   {output(k), outputSpan(reverseMode)});
+    }
+    recordConversion(converter, reverseMode, block, slot.outSize);
+    slot.written = 0;
+    if (positionalOutput) {
+      slot.outOffset = outPosition;
+      outPosition += slot.outSize;
+    }
+    slot.state = slot.outSize > 0 ? Slot::State::Queued : Slot::State::Idle;
+  }
+
+  // Blocks read past the end of a regular file hold nothing
+  if (inputDone) {
+    for (Slot &slot : slots) {
+      if (slot.state == Slot::State::Ready)
+        slot.state = Slot::State::Idle;
+    }
+  }
+
+  // Output with offsets is written as soon as it exists; a stream gets its
+  // oldest queued block once the previous write is done
+  if (positionalOutput) {
+    for (size_t k = 0; k < kSlots; ++k) {
+      if (slots[k].state == Slot::State::Queued)
+        submitWrite(k);
+    }
+    return;
+  }
+  Slot *oldest = nullptr;
+  for (Slot &slot : slots) {
+    if (slot.state == Slot::State::Writing)
+      return;
+    if (slot.state == Slot::State::Queued &&
+        (!oldest || slot.sequence < oldest->sequence))
+      oldest = &slot;
+  }
+  if (oldest)
+    submitWrite(static_cast<size_t>(oldest - slots.data()));
+}
+
+void UringConverter::submitRead(size_t k) {
+  Slot &slot = slots[k];
+  io_uring_sqe *sqe = ring->next();
+  if (!sqe) {
+    error = EBUSY;
+    return;
+  }
+  sqe->opcode = fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe->fd = inFd;
+  sqe->addr = reinterpret_cast<uintptr_t>(input(k) + kHeadRoom + slot.filled);
+  sqe->len = static_cast<uint32_t>(kBlockSize - slot.filled);
+  sqe->off = positionalInput ? slot.inOffset + slot.filled : kCurrentPosition;
+  if (fixedBuffers)
+    sqe->buf_index = static_cast<uint16_t>(2 * k);
+  sqe->user_data = k;
+  slot.state = Slot::State::Reading;
+}
+
+void UringConverter::submitWrite(size_t k) {
+  Slot &slot = slots[k];
+  io_uring_sqe *sqe = ring->next();
+  if (!sqe) {
+    error = EBUSY;
+    return;
+  }
+  sqe->opcode = fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+  sqe->fd = outFd;
+  sqe->addr = reinterpret_cast<uintptr_t>(output(k) + slot.written);
+  sqe->len = static_cast<uint32_t>(slot.outSize - slot.written);
+  sqe->off =
+      positionalOutput ? slot.outOffset + slot.written : kCurrentPosition;
+  if (fixedBuffers)
+    sqe->buf_index = static_cast<uint16_t>(2 * k + 1);
+  sqe->user_data = k;
+  slot.state = Slot::State::Writing;
+}
+
+void UringConverter::complete(size_t k, int result) {
+  Slot &slot = slots[k];
+  bool reading = slot.state == Slot::State::Reading;
+  if (result == -EINTR || result == -EAGAIN) {
+    if (error == 0) {
+      reading ? submitRead(k) : submitWrite(k);
+      return;
+    }
+  }
+  if (result < 0 || error != 0) {
+    if (error == 0)
+      error = -result;
+    slot.state = Slot::State::Idle;
+    return;
+  }
+
+  if (reading) {
+    slot.filled += static_cast<size_t>(result);
+    if (result == 0) {
+      slot.eof = true;
+      readEnd = true;
+    } else if (positionalInput && slot.filled < kBlockSize) {
+      // Short read from a file: fetch the rest, or learn that it ended
+      submitRead(k);
+      return;
+    }
+    slot.state = inputDone ? Slot::State::Idle : Slot::State::Ready;
+    return;
+  }
+
+  slot.written += static_cast<size_t>(result);
+  if (slot.written < slot.outSize) {
+    submitWrite(k);
+    return;
+  }
+  slot.state = Slot::State::Idle;
+}
+
+#else
+
+struct UringConverter::Ring {};
+
+bool UringConverter::supported() { return false; }
+
+UringConverter::UringConverter(const DigitConverter &converter, bool reverse)
+    : converter(converter), reverseMode(reverse) {}
+
+UringConverter::~UringConverter() = default;
+
+bool UringConverter::run(int, int) {
+  errno = ENOSYS;
+  return false;
+}
+
+#endif
+
+} // namespace zenkaku
@@ -0,0 +1,114 @@
+// Runs every stream engine against a library built with
+// ZENKAKU_COUNT_ALLOCATIONS. Each engine checks its own steady-state loops
+// with NoAllocationScope and aborts if one allocates; engines that set
+// nothing up per run are also checked across a whole second run.
+
+#include "test.hpp"
+
+#include <zenkaku/debug.hpp>
+#include <zenkaku/stream.hpp>
+#include <zenkaku/uring.hpp>
+#include <zenkaku/zenkaku.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+using namespace zenkaku;
+using namespace zenkaku::test;
+
+namespace {
+
+// Several blocks of the block-based engines and more than one parallel
+// chunk; the second run of each engine then reuses every buffer
+constexpr size_t kInputSize = ParallelStreamConverter::kChunkSize + 12345;
+
+std::string sampleText() {
+  std::string text;
+  for (size_t k = 0; text.size() < kInputSize; ++k) {
+    text += "entry " + std::to_string(k * 7919) + " \xE2\x91\xA0 ok\n";
+  }
+  return text;
+}
+
+struct Case {
+  const DigitConverter &converter;
+  bool reverse;
+  std::string input;
+  std::string expected;
+};
+
+// Runs `engine` over the case twice and checks both outputs. With
+// `wholeRun`, the second run must not allocate at all.
+template <typename Engine>
+void runTwice(Engine &engine, const Case &c, const char *name,
+              bool wholeRun) {
+  for (int pass = 0; pass < 2; ++pass) {
+    int inFd = tempFile(c.input);
+    int outFd = tempFile();
+    bool ok;
+    if (pass == 1 && wholeRun) {
+      NoAllocationScope scope(name);
+      ok = engine.run(inFd, outFd);
+    } else {
+      ok = engine.run(inFd, outFd);
+    }
+    CHECK(ok);
+    CHECK(readFile(outFd) == c.expected);
+    ::close(inFd);
+    ::close(outFd);
+  }
+}
+
+void testCounter() {
+  size_t before = threadAllocationCount();
+  // Through a volatile pointer, so the pair cannot be optimised away
+  int *volatile allocated = new int(0);
+  delete allocated;
+  CHECK(threadAllocationCount() == before + 1);
+}
+
+void testEngines(const Case &c) {
+  StreamConverter stream(c.converter, c.reverse);
+  runTwice(stream, c, "StreamConverter second run", true);
+
+  MappedFileConverter mapped(c.converter, c.reverse);
+  runTwice(mapped, c, "MappedFileConverter second run", true);
+
+  ParallelStreamConverter parallel(c.converter, c.reverse, 2);
+  runTwice(parallel, c, "ParallelStreamConverter second run", true);
+
+  // These start threads, a ring or per-run chunk tables, so only their
+  // loops are checked
+  PipelineConverter pipeline(c.converter, c.reverse);
+  runTwice(pipeline, c, "PipelineConverter", false);
+
+  MappedParallelConverter mappedParallel(c.converter, c.reverse, 2);
+  runTwice(mappedParallel, c, "MappedParallelConverter", false);
+
+  if (UringConverter::supported()) {
+    UringConverter uring(c.converter, c.reverse);
+    runTwice(uring, c, "UringConverter", false);
+  } else {
+    std::fprintf(stderr, "io_uring unavailable, UringConverter skipped\n");
+  }
+}
+
+} // namespace
+
+int main() {
+  testCounter();
+
+  const DigitConverter &circle = *findConverter("circle");
+  std::string text = sampleText();
+  std::string converted;
+  convertText(circle, false, text, converted);
+  std::string folded;
+  convertText(circle, true, converted, folded);
+
+  testEngines({circle, false, text, converted});
+  testEngines({circle, true, converted, folded});
+  testEngines({*findConverter("any"), true, converted, folded});
+  return testResult();
+}
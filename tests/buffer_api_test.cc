@@ -0,0 +1,213 @@
+// The buffer and in-place entry points, C++ and C, against convertText().
+
+#include "test.hpp"
+
+#include <zenkaku/zenkaku.h>
+#include <zenkaku/zenkaku.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace zenkaku;
+using namespace zenkaku::test;
+
+namespace {
+
+// convertInPlace() and reverseInPlace() stage output through a 16 KiB
+// stack buffer; forward conversion takes a third of that in input per step
+constexpr size_t kChunk = 16 << 10;
+constexpr size_t kForwardStep = kChunk / 3;
+
+std::string converted(const DigitConverter &converter, bool reverse,
+                      const std::string &input) {
+  std::string out;
+  convertText(converter, reverse, input, out);
+  return out;
+}
+
+// Text of `size` bytes without digits, with `insert` placed at `at`.
+std::string textWith(size_t size, size_t at, std::string_view insert) {
+  std::string text(size, 'x');
+  for (size_t k = 63; k < size; k += 64) {
+    text[k] = '\n';
+  }
+  std::copy(insert.begin(), insert.end(), text.begin() + at);
+  return text;
+}
+
+// Converts `input` in place with exactly the required capacity.
+void checkConvertInPlace(const DigitConverter &converter,
+                         const std::string &input) {
+  std::string expected = converted(converter, false, input);
+  std::vector<char> buffer(expected.size());
+  std::copy(input.begin(), input.end(), buffer.begin());
+  auto n = convertInPlace(converter, buffer, input.size());
+  CHECK(n && *n == expected.size());
+  CHECK(std::string(buffer.begin(), buffer.end()) == expected);
+}
+
+void checkReverseInPlace(const DigitConverter &converter,
+                         const std::string &input) {
+  std::string expected = converted(converter, true, input);
+  std::vector<char> buffer(input.begin(), input.end());
+  size_t n = reverseInPlace(converter, buffer);
+  CHECK(n == expected.size());
+  CHECK(std::string(buffer.data(), n) == expected);
+}
+
+void testInPlaceChunkEdges() {
+  const DigitConverter &circle = *findConverter("circle");
+  std::string sequence(circle.getDigits()[4]);
+  constexpr size_t kSize = 3 * kChunk + 100;
+
+  // A digit at and around every forward step boundary, counted from the
+  // end, and a digit at the very start so the steps never stop early
+  for (size_t step = 1; step <= 3; ++step) {
+    for (size_t delta = 0; delta < 5; ++delta) {
+      size_t at = kSize - step * kForwardStep - 2 + delta;
+      std::string input = textWith(kSize, at, "7");
+      input[0] = '1';
+      checkConvertInPlace(circle, input);
+    }
+  }
+
+  // A sequence straddling every reverse chunk boundary, counted from the
+  // first sequence, which is at the very start
+  for (size_t chunk = 1; chunk <= 2; ++chunk) {
+    for (size_t delta = 0; delta < 5; ++delta) {
+      std::string input = textWith(kSize, chunk * kChunk - 2 + delta,
+                                   sequence);
+      std::copy(sequence.begin(), sequence.end(), input.begin());
+      checkReverseInPlace(circle, input);
+      checkReverseInPlace(*findConverter("any"), input);
+    }
+  }
+
+  // Dense input, so every chunk holds many changes
+  std::string dense;
+  for (size_t k = 0; dense.size() < kSize; ++k) {
+    dense += std::to_string(k) + " " + sequence + "\n";
+  }
+  checkConvertInPlace(circle, dense);
+  checkReverseInPlace(circle, dense);
+  checkReverseInPlace(circle, converted(circle, false, dense));
+}
+
+void testInPlaceCapacity() {
+  const DigitConverter &fullwidth = *findConverter("fullwidth");
+  std::string input = textWith(kChunk + 10, kChunk / 2, "2024-10-16");
+  size_t required = requiredSize(fullwidth, input, Direction::Forward);
+  CHECK(required == input.size() + 2 * 8);
+
+  // One byte short: refused, nothing written
+  std::vector<char> buffer(required - 1, '#');
+  std::copy(input.begin(), input.end(), buffer.begin());
+  std::vector<char> before = buffer;
+  CHECK(!convertInPlace(fullwidth, buffer, input.size()));
+  CHECK(buffer == before);
+
+  // Exactly the required size
+  checkConvertInPlace(fullwidth, input);
+}
+
+void testCInPlace() {
+  std::string input = textWith(2 * kChunk, kChunk - 1, "12");
+  std::string expected = converted(*findConverter("fullwidth"), false, input);
+
+  std::vector<char> buffer(expected.size() - 1, '#');
+  std::copy(input.begin(), input.end(), buffer.begin());
+  std::vector<char> before = buffer;
+  size_t written = 0;
+  CHECK(zk_convert_inplace("fullwidth", buffer.data(), input.size(),
+                           buffer.size(), &written) == ZK_BUFFER_TOO_SMALL);
+  CHECK(written == expected.size());
+  CHECK(buffer == before);
+
+  buffer.resize(expected.size());
+  CHECK(zk_convert_inplace("fullwidth", buffer.data(), input.size(),
+                           buffer.size(), &written) == ZK_OK);
+  CHECK(written == expected.size());
+  CHECK(std::string(buffer.begin(), buffer.end()) == expected);
+
+  CHECK(zk_reverse_inplace("fullwidth", buffer.data(), buffer.size(),
+                           &written) == ZK_OK);
+  CHECK(std::string(buffer.data(), written) == input);
+
+  CHECK(zk_convert_inplace("fullwidth", buffer.data(), 10, 9, &written) ==
+        ZK_INVALID_ARGUMENT);
+  CHECK(zk_reverse_inplace("nonesuch", buffer.data(), 10, &written) ==
+        ZK_UNKNOWN_TYPE);
+
+  // 'any' has no forward direction
+  CHECK(zk_convert_inplace("any", buffer.data(), 10, buffer.size(),
+                           &written) == ZK_INVALID_ARGUMENT);
+}
+
+void testCBuffers() {
+  std::string input = "Room 42, floor 7: 1990-2024\n";
+  std::string expected = converted(*findConverter("circle"), false, input);
+  size_t size = 0;
+  size_t written = 0;
+
+  CHECK(zk_required_size("circle", input.data(), input.size(), ZK_FORWARD,
+                         &size) == ZK_OK);
+  CHECK(size == expected.size());
+  CHECK(zk_required_size("circle", expected.data(), expected.size(),
+                         ZK_REVERSE, &size) == ZK_OK);
+  CHECK(size == input.size());
+
+  // Round trip into buffers of exactly the required size
+  std::vector<char> output(expected.size());
+  CHECK(zk_convert("circle", input.data(), input.size(), output.data(),
+                   output.size(), &written) == ZK_OK);
+  CHECK(std::string(output.data(), written) == expected);
+  std::vector<char> back(input.size());
+  CHECK(zk_reverse("circle", output.data(), output.size(), back.data(),
+                   back.size(), &written) == ZK_OK);
+  CHECK(std::string(back.data(), written) == input);
+
+  // One byte short: refused with the size needed, nothing written
+  std::vector<char> small(expected.size() - 1, '#');
+  std::vector<char> before = small;
+  CHECK(zk_convert("circle", input.data(), input.size(), small.data(),
+                   small.size(), &written) == ZK_BUFFER_TOO_SMALL);
+  CHECK(written == expected.size());
+  CHECK(small == before);
+  small.assign(input.size() - 1, '#');
+  before = small;
+  CHECK(zk_reverse("circle", expected.data(), expected.size(), small.data(),
+                   small.size(), &written) == ZK_BUFFER_TOO_SMALL);
+  CHECK(written == input.size());
+  CHECK(small == before);
+
+  // Unknown types
+  CHECK(zk_convert("nonesuch", input.data(), input.size(), output.data(),
+                   output.size(), &written) == ZK_UNKNOWN_TYPE);
+  CHECK(zk_reverse("nonesuch", input.data(), input.size(), output.data(),
+                   output.size(), &written) == ZK_UNKNOWN_TYPE);
+  CHECK(zk_required_size("nonesuch", input.data(), input.size(), ZK_FORWARD,
+                         &size) == ZK_UNKNOWN_TYPE);
+
+  // 'any' folds every script back, but has no forward direction
+  CHECK(zk_reverse("any", expected.data(), expected.size(), back.data(),
+                   back.size(), &written) == ZK_OK);
+  CHECK(std::string(back.data(), written) == input);
+  CHECK(zk_required_size("any", expected.data(), expected.size(), ZK_REVERSE,
+                         &size) == ZK_OK);
+  CHECK(size == input.size());
+  CHECK(zk_convert("any", input.data(), input.size(), output.data(),
+                   output.size(), &written) == ZK_INVALID_ARGUMENT);
+  CHECK(zk_required_size("any", input.data(), input.size(), ZK_FORWARD,
+                         &size) == ZK_INVALID_ARGUMENT);
+}
+
+} // namespace
+
+int main() {
+  testInPlaceChunkEdges();
+  testInPlaceCapacity();
+  testCInPlace();
+  testCBuffers();
+  return testResult();
+}
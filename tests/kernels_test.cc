@@ -0,0 +1,191 @@
+// Every kernel tier this CPU supports against the scalar reference: forward
+// expansion, both scanners, reverse folding and both counting passes.
+
+#include "test.hpp"
+
+#include "kernels.hpp"
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace zenkaku;
+using namespace zenkaku::test;
+
+namespace {
+
+const DigitTable &digits(std::string_view type) {
+  return findConverter(type)->getDigits();
+}
+
+const ExpansionTable kCircleForward = makeExpansionTable(digits("circle"));
+const DigitTrie kCircleTrie{digits("circle")};
+
+// Every script in one trie, as the any-script converter builds it
+const DigitTrie kMergedTrie = [] {
+  DigitTrie trie;
+  for (std::string_view type : defaultRegistry().getAvailableTypes()) {
+    trie.add(digits(type));
+  }
+  return trie;
+}();
+
+// Pieces the random inputs are cut from: plain ASCII, digits, digit
+// sequences of several scripts, sequences that share a lead byte with them
+// but fold to nothing, and lone or truncated multi-byte prefixes.
+const std::vector<std::string> kPieces = {
+    "a", " ", "\n", "xyz", "0", "5", "9", "/", ":",
+    std::string(digits("circle")[0]), std::string(digits("circle")[7]),
+    std::string(digits("fullwidth")[3]), std::string(digits("chinese")[9]),
+    std::string(digits("thai")[1]), std::string(digits("roman")[4]),
+    "\xE3\x80\x87", "\xE3\x80\x88", "\xE2\x91\xFF", "\xE2\x80\x80",
+    "\xC3\xA9", "\xF0\x9F\x98\x80", "\xE2\x91", "\xEF\xBC", "\xE2", "\x80",
+    "\xBF", "\xFF"};
+
+std::string randomInput(std::mt19937 &random, size_t size) {
+  std::uniform_int_distribution<size_t> pick(0, kPieces.size() - 1);
+  std::string input;
+  while (input.size() < size) {
+    input += kPieces[pick(random)];
+  }
+  input.resize(size);
+  return input;
+}
+
+// Forward output with the end of the output buffer at exactly the required
+// size, so a kernel that stores past it trips the guard bytes.
+std::string expandTight(const KernelSet &kernels, std::string_view input) {
+  size_t size = input.size() + 2 * countDigitsScalar(input);
+  constexpr size_t kGuard = 256;
+  std::vector<char> buffer(size + kGuard, '\x5A');
+  char *end = kernels.expand(input, buffer.data(), buffer.data() + size,
+                             kCircleForward);
+  for (size_t k = size; k < buffer.size(); ++k) {
+    if (buffer[k] != '\x5A') {
+      CHECK(!"expand wrote past dstEnd");
+      break;
+    }
+  }
+  return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+}
+
+std::string expandRoomy(const KernelSet &kernels, std::string_view input) {
+  std::vector<char> buffer(3 * input.size() + 1);
+  char *end = kernels.expand(input, buffer.data(),
+                             buffer.data() + buffer.size(), kCircleForward);
+  return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+}
+
+std::string expandReference(std::string_view input) {
+  std::vector<char> buffer(3 * input.size() + 1);
+  char *end = expandDigitsScalar(input, buffer.data(), digits("circle"));
+  return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+}
+
+std::string reverseWith(const KernelSet &kernels, std::string_view input,
+                        const DigitTrie &trie) {
+  std::vector<char> buffer(input.size() + 1);
+  char *end = kernels.reverse(input, buffer.data(), trie);
+  return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+}
+
+std::string reverseReference(std::string_view input, const DigitTrie &trie) {
+  std::vector<char> buffer(input.size() + 1);
+  char *end =
+      reverseDigitsWith<findLeadByteScalar>(input, buffer.data(), trie);
+  return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+}
+
+// Compares every hot path of `kernels` with the scalar reference on
+// `input`. The input is copied into its own allocation first, so a kernel
+// reading past the end is caught by sanitizer builds.
+void compare(const KernelSet &kernels, std::string_view text) {
+  std::vector<char> owned(text.begin(), text.end());
+  std::string_view input(owned.data(), owned.size());
+
+  CHECK(expandTight(kernels, input) == expandReference(input));
+  CHECK(expandRoomy(kernels, input) == expandReference(input));
+
+  for (size_t from = 0; from <= input.size(); from += 1 + from / 8) {
+    CHECK(kernels.findDigit(input, from) == findDigitScalar(input, from));
+    for (const DigitTrie *trie : {&kCircleTrie, &kMergedTrie}) {
+      CHECK(kernels.findLeadByte(input, from, trie->leadBytes()) ==
+            findLeadByteScalar(input, from, trie->leadBytes()));
+    }
+  }
+
+  for (const DigitTrie *trie : {&kCircleTrie, &kMergedTrie}) {
+    CHECK(reverseWith(kernels, input, *trie) ==
+          reverseReference(input, *trie));
+  }
+
+  CHECK(kernels.countDigits(input) == countDigitsScalar(input));
+  for (const DigitTrie *trie : {&kCircleTrie, &kMergedTrie}) {
+    size_t sequences = kernels.countSequences(input, *trie);
+    CHECK(sequences == countSequencesWith<findLeadByteScalar>(input, *trie));
+    // Every folded sequence is three bytes in and one out
+    CHECK(input.size() - 2 * sequences ==
+          reverseReference(input, *trie).size());
+  }
+}
+
+void testKernel(Kernel kernel) {
+  CHECK(selectKernel(kernel));
+  CHECK(activeKernel() == kernel);
+  const KernelSet &kernels = activeKernels;
+  std::mt19937 random(12345);
+
+  // Every length through four 64-byte blocks, so each tier's block loop,
+  // its tail and the hand-over between them are all covered
+  for (size_t size = 0; size <= 4 * 64 + 1; ++size) {
+    for (int round = 0; round < 4; ++round) {
+      compare(kernels, randomInput(random, size));
+    }
+  }
+
+  // Digits only, so the forward output is three times the input and the
+  // wide kernels stop short of dstEnd
+  for (size_t size : {15u, 16u, 17u, 31u, 32u, 33u, 63u, 64u, 65u, 200u}) {
+    std::string digits;
+    for (size_t k = 0; k < size; ++k) {
+      digits.push_back(static_cast<char>('0' + k % 10));
+    }
+    compare(kernels, digits);
+  }
+
+  // A sequence at every offset across the 16-, 32- and 64-byte block
+  // edges, whole, split by the end of input, and truncated
+  std::string sequence(digits("circle")[5]);
+  for (size_t at = 0; at <= 2 * 64; ++at) {
+    std::string filler(at, 'x');
+    compare(kernels, filler + sequence + filler);
+    compare(kernels, filler + sequence);
+    compare(kernels, filler + sequence.substr(0, 2));
+    compare(kernels, filler + sequence.substr(0, 1) + "7" + filler);
+  }
+
+  // Longer mixed input for the steady-state loops
+  for (int round = 0; round < 8; ++round) {
+    compare(kernels, randomInput(random, 4096 + round));
+  }
+}
+
+} // namespace
+
+int main() {
+  Kernel initial = activeKernel();
+  for (Kernel kernel : kKernels) {
+    if (kernelSupported(kernel)) {
+      testKernel(kernel);
+    } else {
+      std::fprintf(stderr, "kernel %s unsupported here, skipped\n",
+                   std::string(kernelName(kernel)).c_str());
+    }
+  }
+  selectKernel(initial);
+  return testResult();
+}
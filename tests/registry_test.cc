@@ -0,0 +1,109 @@
+// ConverterRegistry built at run time: lookups, the entries its constructor
+// refuses, and the any-script converter built from one.
+
+#include "test.hpp"
+
+#include <zenkaku/zenkaku.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace zenkaku;
+using namespace zenkaku::test;
+
+namespace {
+
+using Entry = ConverterRegistry::Entry;
+
+const DigitConverter *kCircle = findConverter("circle");
+
+void testLookup() {
+  // A full table of names the built-ins do not use
+  std::vector<std::string> names;
+  std::vector<Entry> entries;
+  for (size_t k = 0; k < ConverterRegistry::kMaxConverters; ++k) {
+    names.push_back("script" + std::to_string(k));
+  }
+  for (const std::string &name : names) {
+    entries.push_back({name, kCircle});
+  }
+  ConverterRegistry registry(entries);
+
+  CHECK(registry.getAvailableTypes().size() == names.size());
+  for (size_t k = 0; k < names.size(); ++k) {
+    CHECK(registry.getAvailableTypes()[k] == names[k]);
+    CHECK(registry.getConverter(names[k]) == kCircle);
+  }
+  CHECK(registry.getConverter("circle") == nullptr);
+  CHECK(registry.getConverter("") == nullptr);
+
+  ConverterRegistry empty(std::span<const Entry>{});
+  CHECK(empty.getAvailableTypes().empty());
+  CHECK(empty.getConverter("circle") == nullptr);
+}
+
+void testRefused() {
+  std::vector<std::string> names;
+  for (size_t k = 0; k <= ConverterRegistry::kMaxConverters; ++k) {
+    names.push_back("script" + std::to_string(k));
+  }
+  std::vector<Entry> tooMany;
+  for (const std::string &name : names) {
+    tooMany.push_back({name, kCircle});
+  }
+  bool threw = false;
+  try {
+    ConverterRegistry registry(tooMany);
+  } catch (const std::length_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+
+  // Two equal names hash alike for every seed
+  const Entry duplicate[] = {{"circle", kCircle}, {"roman", kCircle},
+                             {"circle", kCircle}};
+  threw = false;
+  try {
+    ConverterRegistry registry(duplicate);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+void testAnyScript() {
+  // Built from a registry, the any-script converter folds its scripts
+  const Entry scripts[] = {{"circle", kCircle},
+                           {"roman", findConverter("roman")}};
+  ConverterRegistry registry(scripts);
+  auto any = makeAnyScriptConverter(registry);
+  std::string text = "7 and 12";
+  std::string folded;
+  for (const Entry &entry : scripts) {
+    std::string script;
+    entry.converter->convert(text, script);
+    folded.clear();
+    any->reverse(script, folded);
+    CHECK(folded == text);
+  }
+
+  // Its own digits are ASCII, which the trie cannot hold
+  const Entry nested[] = {{"circle", kCircle}, {"any", any.get()}};
+  bool threw = false;
+  try {
+    makeAnyScriptConverter(ConverterRegistry(nested));
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+} // namespace
+
+int main() {
+  testLookup();
+  testRefused();
+  testAnyScript();
+  return testResult();
+}
@@ -0,0 +1,343 @@
+// ConversionServer driven by ConversionClient and by raw frames over a
+// socket in a temporary directory, against convertText().
+
+#include "test.hpp"
+
+#include <zenkaku/server.hpp>
+#include <zenkaku/zenkaku.hpp>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace zenkaku;
+using namespace zenkaku::test;
+
+namespace {
+
+std::string converted(std::string_view type, bool reverse,
+                      std::string_view input) {
+  std::string out;
+  convertText(*findConverter(type), reverse, input, out);
+  return out;
+}
+
+// Big-endian u32, as the protocol frames it
+std::string u32(uint32_t value) {
+  return {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+          static_cast<char>(value >> 8), static_cast<char>(value)};
+}
+
+// One request frame, built by hand so a test can send several at once or
+// break the header.
+std::string frame(uint8_t direction, std::string_view type,
+                  std::string_view payload) {
+  std::string out;
+  out += static_cast<char>(direction);
+  out += static_cast<char>(type.size());
+  out += u32(static_cast<uint32_t>(payload.size()));
+  out += type;
+  out += payload;
+  return out;
+}
+
+sockaddr_un socketAddress(const std::string &path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.data(), path.size());
+  return addr;
+}
+
+// Raw connection to the server at `path`, for sending frames the client
+// would not build.
+int connectRaw(const std::string &path) {
+  sockaddr_un addr = socketAddress(path);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    std::perror("connect");
+    std::abort();
+  }
+  return fd;
+}
+
+bool sendAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+// Everything the server sends until it closes the connection.
+std::string readToEnd(int fd) {
+  std::string data;
+  char block[4096];
+  while (true) {
+    ssize_t n = ::read(fd, block, sizeof(block));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return data;
+    data.append(block, static_cast<size_t>(n));
+  }
+}
+
+// The response frames in `data`, in order.
+struct Reply {
+  ResponseStatus status;
+  std::string body;
+};
+
+std::vector<Reply> parseReplies(std::string_view data) {
+  std::vector<Reply> replies;
+  while (data.size() >= kResponseHeaderSize) {
+    auto byte = [&](size_t i) {
+      return static_cast<uint32_t>(static_cast<uint8_t>(data[i]));
+    };
+    uint32_t length = byte(1) << 24 | byte(2) << 16 | byte(3) << 8 | byte(4);
+    if (data.size() - kResponseHeaderSize < length)
+      break;
+    replies.push_back({static_cast<ResponseStatus>(data[0]),
+                       std::string(data.substr(kResponseHeaderSize, length))});
+    data.remove_prefix(kResponseHeaderSize + length);
+  }
+  CHECK(data.empty());
+  return replies;
+}
+
+const std::string kText = "Room 42, floor 7: 1990-2024\n";
+
+void testRequests(const std::string &path) {
+  ConversionClient client;
+  CHECK(client.connect(path));
+  ConversionClient::Response response;
+
+  for (std::string_view type : defaultRegistry().getAvailableTypes()) {
+    CHECK(client.request(type, RequestDirection::Forward, kText, response));
+    CHECK(response.status == ResponseStatus::Ok);
+    CHECK(response.body == converted(type, false, kText));
+
+    std::string script = response.body;
+    CHECK(client.request(type, RequestDirection::Reverse, script, response));
+    CHECK(response.status == ResponseStatus::Ok);
+    CHECK(response.body == converted(type, true, script));
+  }
+
+  // An unknown type is answered and the connection stays usable
+  CHECK(client.request("klingon", RequestDirection::Forward, kText, response));
+  CHECK(response.status == ResponseStatus::UnknownType);
+  CHECK(client.request("circle", RequestDirection::Forward, kText, response));
+  CHECK(response.status == ResponseStatus::Ok);
+  CHECK(response.body == converted("circle", false, kText));
+
+  // An empty payload
+  CHECK(client.request("thai", RequestDirection::Forward, "", response));
+  CHECK(response.status == ResponseStatus::Ok);
+  CHECK(response.body.empty());
+}
+
+void testAnyReverse(const std::string &path) {
+  ConversionClient client;
+  CHECK(client.connect(path));
+  ConversionClient::Response response;
+
+  // Digits of every script in one payload fold back in one request
+  std::string mixed;
+  for (std::string_view type : defaultRegistry().getAvailableTypes()) {
+    mixed += converted(type, false, kText);
+  }
+  CHECK(client.request("any", RequestDirection::Reverse, mixed, response));
+  CHECK(response.status == ResponseStatus::Ok);
+  CHECK(response.body == converted("any", true, mixed));
+
+  std::string expected;
+  for (size_t k = 0; k < defaultRegistry().getAvailableTypes().size(); ++k) {
+    expected += kText;
+  }
+  CHECK(response.body == expected);
+
+  // 'any' has no forward direction
+  CHECK(client.request("any", RequestDirection::Forward, kText, response));
+  CHECK(response.status == ResponseStatus::BadRequest);
+}
+
+void testPipelined(const std::string &path) {
+  // Every request goes out in one write before any response is read, and
+  // the responses come back in request order
+  std::string requests;
+  std::vector<Reply> expected;
+  for (size_t k = 0; k < 64; ++k) {
+    std::string payload = kText + std::to_string(k);
+    auto types = defaultRegistry().getAvailableTypes();
+    std::string_view type = types[k % types.size()];
+    if (k % 7 == 3) {
+      requests += frame(0, "nope", payload);
+      expected.push_back({ResponseStatus::UnknownType, {}});
+    } else {
+      requests += frame(0, type, payload);
+      expected.push_back({ResponseStatus::Ok, converted(type, false, payload)});
+    }
+  }
+  // A large payload spans many reads on the server side
+  std::string large(kMaxRequestPayload / 4, 'x');
+  for (size_t k = 0; k < large.size(); k += 97) {
+    large[k] = static_cast<char>('0' + k % 10);
+  }
+  requests += frame(0, "roman", large);
+  expected.push_back({ResponseStatus::Ok, converted("roman", false, large)});
+
+  int fd = connectRaw(path);
+  // Send from another thread so neither side blocks on a full socket
+  std::thread writer([&] {
+    CHECK(sendAll(fd, requests));
+    ::shutdown(fd, SHUT_WR);
+  });
+  std::vector<Reply> replies = parseReplies(readToEnd(fd));
+  writer.join();
+  ::close(fd);
+
+  CHECK(replies.size() == expected.size());
+  for (size_t k = 0; k < replies.size() && k < expected.size(); ++k) {
+    CHECK(replies[k].status == expected[k].status);
+    if (expected[k].status == ResponseStatus::Ok)
+      CHECK(replies[k].body == expected[k].body);
+  }
+}
+
+void testMalformedHeader(const std::string &path) {
+  // A request before the bad header is still answered; the bad header gets
+  // BadRequest and the server closes, ignoring anything after it
+  for (std::string bad : {frame(2, "circle", kText),
+                          std::string{0, 6} + u32(kMaxRequestPayload + 1)}) {
+    int fd = connectRaw(path);
+    CHECK(sendAll(fd, frame(0, "circle", kText) + bad +
+                          frame(0, "circle", kText)));
+    std::vector<Reply> replies = parseReplies(readToEnd(fd));
+    ::close(fd);
+    CHECK(replies.size() == 2);
+    if (replies.size() == 2) {
+      CHECK(replies[0].status == ResponseStatus::Ok);
+      CHECK(replies[0].body == converted("circle", false, kText));
+      CHECK(replies[1].status == ResponseStatus::BadRequest);
+    }
+  }
+
+  // The server keeps serving other clients
+  ConversionClient client;
+  CHECK(client.connect(path));
+  ConversionClient::Response response;
+  CHECK(client.request("circle", RequestDirection::Forward, kText, response));
+  CHECK(response.status == ResponseStatus::Ok);
+}
+
+void testListenRefuses(const std::string &dir, const std::string &live) {
+  // A path that is not a socket is never removed
+  std::string file = dir + "/file";
+  int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+  CHECK(fd >= 0);
+  ::close(fd);
+  {
+    ConversionServer server;
+    CHECK(!server.listen(file));
+    CHECK(errno == EEXIST);
+  }
+  struct stat st;
+  CHECK(::lstat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode));
+  ::unlink(file.c_str());
+
+  // Nor is the socket of a server that is still listening
+  {
+    ConversionServer server;
+    CHECK(!server.listen(live));
+    CHECK(errno == EADDRINUSE);
+  }
+  CHECK(::lstat(live.c_str(), &st) == 0 && S_ISSOCK(st.st_mode));
+}
+
+// Run before the serving server starts: a server that listens takes over
+// the wake-up eventfd that stop() signals.
+void testListenReplacesStale(const std::string &dir) {
+  // A socket nobody listens on is replaced
+  std::string stale = dir + "/stale.sock";
+  sockaddr_un addr = socketAddress(stale);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  CHECK(::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+  ::close(fd);
+  {
+    ConversionServer server;
+    CHECK(server.listen(stale));
+  }
+  struct stat st;
+  CHECK(::lstat(stale.c_str(), &st) != 0);
+}
+
+void testServerGone(const std::string &dir) {
+  // A peer that accepts and hangs up at once: the request fails with an
+  // error instead of killing the process with SIGPIPE
+  std::string path = dir + "/gone.sock";
+  sockaddr_un addr = socketAddress(path);
+  int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  CHECK(::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+        0);
+  CHECK(::listen(listener, 1) == 0);
+
+  ConversionClient client;
+  CHECK(client.connect(path));
+  ::close(::accept(listener, nullptr, nullptr));
+  ::close(listener);
+  ::unlink(path.c_str());
+
+  ConversionClient::Response response;
+  std::string payload(kMaxRequestPayload, '1');
+  CHECK(!client.request("circle", RequestDirection::Forward, payload,
+                        response));
+  CHECK(errno == EPIPE || errno == ECONNRESET);
+}
+
+} // namespace
+
+int main() {
+  char dir[] = "/tmp/zenkaku_test_XXXXXX";
+  if (!::mkdtemp(dir)) {
+    std::perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  std::string path = std::string(dir) + "/server.sock";
+  testListenReplacesStale(dir);
+  testServerGone(dir);
+
+  {
+    ConversionServer server;
+    if (!server.listen(path)) {
+      std::perror("listen");
+      return EXIT_FAILURE;
+    }
+    std::thread serving([&server] { CHECK(server.run()); });
+
+    testRequests(path);
+    testAnyReverse(path);
+    testPipelined(path);
+    testMalformedHeader(path);
+    testListenRefuses(dir, path);
+
+    ConversionServer::stop();
+    serving.join();
+  }
+  // The server removes its socket when it goes away
+  struct stat st;
+  CHECK(::lstat(path.c_str(), &st) != 0);
+  ::rmdir(dir);
+  return testResult();
+}
@@ -0,0 +1,293 @@
+// The file engines against StreamConverter, the reference stream engine,
+// and StreamConverter itself across read(2) boundaries. All are reached
+// through the zenkaku binary: input on stdin is streamed, input named with
+// -i is mapped.
+
+#include "test.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace zenkaku::test;
+
+namespace {
+
+constexpr size_t kBlockSize = 1 << 20;
+constexpr size_t kChunkSize = 4 << 20;
+constexpr size_t kMinZeroCopy = 4096;
+constexpr size_t kMaxRegion = 256 << 10;
+
+// Fullwidth digit `d`, U+FF10 + d
+std::string fullwidth(size_t d) {
+  return {'\xEF', '\xBC', static_cast<char>(0x90 + d)};
+}
+
+// Named temporary file holding `data`, removed on destruction.
+class TempPath {
+public:
+  explicit TempPath(std::string_view data) {
+    fd = ::mkstemp(path);
+    if (fd < 0) {
+      std::perror("mkstemp");
+      std::abort();
+    }
+    if (::pwrite(fd, data.data(), data.size(), 0) !=
+        static_cast<ssize_t>(data.size())) {
+      std::perror("pwrite");
+      std::abort();
+    }
+  }
+  ~TempPath() {
+    ::close(fd);
+    ::unlink(path);
+  }
+
+  char path[32] = "/tmp/zenkaku_test_XXXXXX";
+  int fd;
+};
+
+// Output of the zenkaku binary given `args` and `input`, which is mapped
+// through -i if `mapped` and read from stdin otherwise.
+std::string run(std::vector<std::string> args, std::string_view input,
+                bool mapped) {
+  TempPath in(input);
+  int outFd = tempFile();
+  if (mapped) {
+    args.push_back("-i");
+    args.push_back(in.path);
+  }
+
+  std::vector<char *> argv{const_cast<char *>(ZENKAKU_CLI_PATH)};
+  for (std::string &arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  ::posix_spawn_file_actions_init(&actions);
+  if (!mapped)
+    ::posix_spawn_file_actions_adddup2(&actions, in.fd, STDIN_FILENO);
+  ::posix_spawn_file_actions_adddup2(&actions, outFd, STDOUT_FILENO);
+  pid_t pid;
+  int status = -1;
+  if (::posix_spawn(&pid, ZENKAKU_CLI_PATH, &actions, nullptr, argv.data(),
+                    environ) == 0)
+    ::waitpid(pid, &status, 0);
+  ::posix_spawn_file_actions_destroy(&actions);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  std::string output = readFile(outFd);
+  ::close(outFd);
+  return output;
+}
+
+bool writeAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n = ::write(fd, data.data(), data.size());
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+// Output of the zenkaku binary given `args`, with `pieces` written to its
+// stdin through a pipe one at a time. The pause after each piece lets the
+// binary drain the pipe, so its reads end where the pieces do.
+std::string runPiped(std::vector<std::string> args,
+                     const std::vector<std::string> &pieces) {
+  int fds[2];
+  if (::pipe2(fds, O_CLOEXEC) != 0) {
+    std::perror("pipe2");
+    std::abort();
+  }
+  int outFd = tempFile();
+
+  std::vector<char *> argv{const_cast<char *>(ZENKAKU_CLI_PATH)};
+  for (std::string &arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  ::posix_spawn_file_actions_init(&actions);
+  ::posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+  ::posix_spawn_file_actions_adddup2(&actions, outFd, STDOUT_FILENO);
+  pid_t pid;
+  bool spawned = ::posix_spawn(&pid, ZENKAKU_CLI_PATH, &actions, nullptr,
+                               argv.data(), environ) == 0;
+  ::posix_spawn_file_actions_destroy(&actions);
+  ::close(fds[0]);
+
+  for (const std::string &piece : pieces) {
+    CHECK(spawned && writeAll(fds[1], piece));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  ::close(fds[1]);
+  int status = -1;
+  if (spawned)
+    ::waitpid(pid, &status, 0);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  std::string output = readFile(outFd);
+  ::close(outFd);
+  return output;
+}
+
+// True if mapping `input` gives the same output as streaming it.
+bool sameOutput(const std::vector<std::string> &args, std::string_view input) {
+  return run(args, input, true) == run(args, input, false);
+}
+
+// A run of unchanged text just long enough to be written from the mapping.
+std::string unchangedRun(size_t k) {
+  std::string run(kMinZeroCopy - 1, static_cast<char>('a' + k % 26));
+  run.push_back('\n');
+  return run;
+}
+
+void testMappedBatches() {
+  constexpr size_t kRuns = 3 * IOV_MAX;
+
+  // Unchanged runs alternate with single changes, so the pending writev()
+  // list fills up several times with converted bytes queued from the
+  // scratch buffer. Every change differs from its neighbours, so one that
+  // is overwritten before it is written shows up in the output.
+  std::string forward;
+  std::string backward;
+  for (size_t k = 0; k < kRuns; ++k) {
+    forward += unchangedRun(k) + static_cast<char>('0' + k % 10);
+    backward += unchangedRun(k) + fullwidth(k % 10);
+  }
+  // A leading change puts converted output first in every batch
+  forward.insert(0, "7");
+  backward.insert(0, fullwidth(7));
+
+  CHECK(sameOutput({"-t", "fullwidth"}, forward));
+  CHECK(sameOutput({"-t", "fullwidth", "-r"}, backward));
+  CHECK(sameOutput({"-t", "any", "-r"}, backward));
+}
+
+void testMappedDense() {
+  // Changes closer together than kMinZeroCopy are converted as one region
+  std::string input;
+  for (size_t k = 0; input.size() < 3 * kMaxRegion; ++k) {
+    input += "line " + std::to_string(k) + "\n";
+  }
+  CHECK(sameOutput({"-t", "circle"}, input));
+  std::string converted = run({"-t", "circle"}, input, false);
+  CHECK(run({"-t", "circle", "-r"}, converted, true) == input);
+}
+
+void testMappedEmpty() {
+  CHECK(run({"-t", "fullwidth"}, "", true).empty());
+  CHECK(run({"-t", "fullwidth", "-r"}, "", true).empty());
+}
+
+void testOutputIsInput() {
+  // Naming the input as -o is refused before the input is truncated
+  std::string input = "line 1\nline 2\n";
+  TempPath file(input);
+  for (const char *jobs : {"1", "4"}) {
+    char *argv[] = {const_cast<char *>(ZENKAKU_CLI_PATH),
+                    const_cast<char *>("-t"), const_cast<char *>("circle"),
+                    const_cast<char *>("-j"), const_cast<char *>(jobs),
+                    const_cast<char *>("-i"), file.path,
+                    const_cast<char *>("-o"), file.path,
+                    nullptr};
+    pid_t pid;
+    int status = -1;
+    if (::posix_spawn(&pid, ZENKAKU_CLI_PATH, nullptr, nullptr, argv,
+                      environ) == 0)
+      ::waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) != 0);
+    CHECK(readFile(file.fd) == input);
+  }
+}
+
+void testStreamCarry() {
+  // A sequence across the end of the first read, cut after one or two of
+  // its bytes, is carried into the next read and folded whole. On a regular
+  // file the first read ends at kBlockSize; on a pipe, where the writer
+  // stops.
+  std::string tail(100, 'y');
+  for (size_t at : {kBlockSize - 1, kBlockSize - 2}) {
+    std::string head(at, 'x');
+    head[at / 2] = '\n';
+    std::string input = head + fullwidth(7) + tail;
+    std::string expected = head + "7" + tail;
+    CHECK(run({"-t", "fullwidth", "-r"}, input, false) == expected);
+    size_t cut = kBlockSize - at;
+    CHECK(runPiped({"-t", "fullwidth", "-r"},
+                   {head + fullwidth(7).substr(0, cut),
+                    fullwidth(7).substr(cut) + tail}) == expected);
+    CHECK(runPiped({"-t", "any", "-r"},
+                   {head + fullwidth(7).substr(0, cut),
+                    fullwidth(7).substr(cut) + tail}) == expected);
+  }
+
+  // A sequence truncated by the end of input is passed through unchanged,
+  // whether the input ends in the first read or the second
+  for (size_t size : {size_t{64}, kBlockSize - 1, kBlockSize + 1}) {
+    for (size_t cut : {1u, 2u}) {
+      std::string input = std::string(size, 'x') + fullwidth(3) +
+                          fullwidth(4).substr(0, cut);
+      std::string expected = std::string(size, 'x') + "3" +
+                             fullwidth(4).substr(0, cut);
+      CHECK(run({"-t", "fullwidth", "-r"}, input, false) == expected);
+      CHECK(runPiped({"-t", "fullwidth", "-r"}, {input}) == expected);
+    }
+  }
+}
+
+void testParallelOrder() {
+  // Several chunks of numbered lines with one line longer than a chunk in
+  // the middle, so that chunk is cut at a UTF-8 boundary instead of a
+  // newline. -j 4 must match the single-threaded output byte for byte.
+  std::string forward;
+  std::string backward;
+  for (size_t k = 0; forward.size() < 2 * kChunkSize; ++k) {
+    forward += "line " + std::to_string(k) + "\n";
+  }
+  backward = forward;
+  for (size_t k = 0; k < kChunkSize + kChunkSize / 4; k += 3) {
+    forward += static_cast<char>('0' + k % 10);
+    backward += fullwidth(k % 10);
+  }
+  for (size_t k = 0; forward.size() < 5 * kChunkSize; ++k) {
+    std::string line = "after " + std::to_string(k) + "\n";
+    forward += line;
+    backward += line;
+  }
+  backward += fullwidth(1) + fullwidth(2).substr(0, 2);
+
+  CHECK(run({"-t", "circle", "-j", "4"}, forward, false) ==
+        run({"-t", "circle"}, forward, false));
+  CHECK(run({"-t", "fullwidth", "-r", "-j", "4"}, backward, false) ==
+        run({"-t", "fullwidth", "-r"}, backward, false));
+  CHECK(run({"-t", "any", "-r", "-j", "3"}, backward, false) ==
+        run({"-t", "any", "-r"}, backward, false));
+}
+
+} // namespace
+
+int main() {
+  testMappedBatches();
+  testMappedDense();
+  testMappedEmpty();
+  testOutputIsInput();
+  testStreamCarry();
+  testParallelOrder();
+  return testResult();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// Minimal test harness shared by the ctest executables: CHECK() reports a
+// failed condition and lets the test carry on, and the exit status of
+// testResult() tells ctest whether any check failed.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+namespace zenkaku::test {
+
+inline int failures = 0;
+
+inline void check(bool ok, const char *condition, const char *file,
+                  int line) {
+  if (ok)
+    return;
+  std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+  ++failures;
+}
+
+inline int testResult() {
+  if (failures > 0)
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+  return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Anonymous temporary file, removed when closed. Aborts if none can be
+// made, since no test can run without it.
+inline int tempFile() {
+  char path[] = "/tmp/zenkaku_test_XXXXXX";
+  int fd = ::mkstemp(path);
+  if (fd < 0) {
+    std::perror("mkstemp");
+    std::abort();
+  }
+  ::unlink(path);
+  return fd;
+}
+
+// Temporary file holding `data`, positioned at its start.
+inline int tempFile(std::string_view data) {
+  int fd = tempFile();
+  if (::pwrite(fd, data.data(), data.size(), 0) !=
+      static_cast<ssize_t>(data.size())) {
+    std::perror("pwrite");
+    std::abort();
+  }
+  return fd;
+}
+
+// Everything in `fd` from offset 0.
+inline std::string readFile(int fd) {
+  std::string data;
+  char block[1 << 16];
+  off_t offset = 0;
+  while (true) {
+    ssize_t n = ::pread(fd, block, sizeof(block), offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return data;
+    data.append(block, static_cast<size_t>(n));
+    offset += n;
+  }
+}
+
+} // namespace zenkaku::test
+
+#define CHECK(condition)                                                       \
+  ::zenkaku::test::check(static_cast<bool>(condition), #condition, __FILE__,  \
+                         __LINE__)
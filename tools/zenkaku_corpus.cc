@@ -0,0 +1,269 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zenkaku/stream.hpp>
+#include <zenkaku/utf8.hpp>
+#include <zenkaku/zenkaku.hpp>
+
+// Include the CLI11 single-header file
+#include <CLI/CLI.hpp>
+
+using namespace zenkaku;
+
+namespace {
+
+// --- Deterministic Randomness ---
+// splitmix64, written out rather than taken from <random>: the standard
+// distributions are implementation-defined, and corpora must come out
+// byte-identical on every platform and standard library.
+class Random {
+public:
+  explicit Random(uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, bound)
+  size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+
+  // True with probability `percent` / 100
+  bool chance(unsigned percent) { return below(100) < percent; }
+
+  std::string_view pick(std::span<const std::string_view> words) {
+    return words[below(words.size())];
+  }
+
+  // `length` ASCII digits, without a leading zero unless `length` is 1
+  void digits(std::string &out, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+      size_t low = i == 0 && length > 1 ? 1 : 0;
+      out.push_back(static_cast<char>('0' + low + below(10 - low)));
+    }
+  }
+
+private:
+  uint64_t state;
+};
+
+// --- Profiles ---
+// Each profile appends one line (or, for long lines, one run of words) to
+// `out`. Digits are always ASCII here; the converters produce the native
+// forms for the reverse corpora.
+constexpr std::string_view kJapaneseWords[] = {
+    "今日は", "東京で", "会議が", "ありました", "私たちは", "新しい",
+    "計画について", "話し合い", "その結果", "来年の", "予算を", "決めました",
+    "駅前の", "店では", "商品が", "よく売れて", "います", "天気が",
+    "良かったので", "公園を", "散歩しました", "報告書を", "まとめて",
+    "提出する", "予定です", "皆さん", "ご協力", "ありがとう", "ございます",
+};
+
+void appendProse(Random &random, std::string &out) {
+  size_t sentences = 1 + random.below(4);
+  for (size_t s = 0; s < sentences; ++s) {
+    size_t words = 3 + random.below(6);
+    for (size_t w = 0; w < words; ++w) {
+      // Digits are sparse: a date, a count or a price now and then
+      if (random.chance(4)) {
+        switch (random.below(3)) {
+        case 0:
+          random.digits(out, 4);
+          out += "年";
+          random.digits(out, 1 + random.below(2));
+          out += "月";
+          break;
+        case 1:
+          random.digits(out, 1 + random.below(3));
+          out += "人";
+          break;
+        default:
+          random.digits(out, 3 + random.below(4));
+          out += "円";
+          break;
+        }
+      }
+      out += random.pick(kJapaneseWords);
+      if (w + 1 < words && random.chance(20))
+        out += "、";
+    }
+    out += "。";
+  }
+  out += '\n';
+}
+
+constexpr std::string_view kProductNames[] = {
+    "widget", "gadget", "bolt", "nut", "washer", "bracket", "hinge", "spring",
+};
+
+void appendCsv(Random &random, std::string &out, bool header) {
+  if (header) {
+    out += "id,date,product,quantity,unit_price,total,phone\n";
+    return;
+  }
+  random.digits(out, 6);
+  out += ',';
+  out += "20";
+  random.digits(out, 2);
+  out += '-';
+  random.digits(out, 2);
+  out += '-';
+  random.digits(out, 2);
+  out += ',';
+  out += random.pick(kProductNames);
+  out += ',';
+  random.digits(out, 1 + random.below(3));
+  out += ',';
+  random.digits(out, 1 + random.below(4));
+  out += '.';
+  random.digits(out, 2);
+  out += ',';
+  random.digits(out, 2 + random.below(5));
+  out += '.';
+  random.digits(out, 2);
+  out += ",0";
+  random.digits(out, 2);
+  out += '-';
+  random.digits(out, 4);
+  out += '-';
+  random.digits(out, 4);
+  out += '\n';
+}
+
+constexpr std::string_view kThaiWords[] = {
+    "วันนี้", "เรา", "ไป", "ตลาด", "ซื้อ", "ผลไม้", "ราคา", "บาท",
+    "จำนวน", "ชิ้น", "ที่", "กรุงเทพ", "เวลา", "นาฬิกา", "ครับ", "ค่ะ",
+};
+
+// Native Thai digits U+0E50..U+0E59
+void appendThaiDigits(Random &random, std::string &out, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    out += encodeUtf8(U'๐' + static_cast<char32_t>(random.below(10))).view();
+  }
+}
+
+void appendThai(Random &random, std::string &out) {
+  size_t words = 4 + random.below(10);
+  for (size_t w = 0; w < words; ++w) {
+    if (w > 0)
+      out += ' ';
+    // Native and ASCII digits mixed in the same text
+    if (random.chance(15)) {
+      size_t length = 1 + random.below(4);
+      if (random.chance(50)) {
+        appendThaiDigits(random, out, length);
+      } else {
+        random.digits(out, length);
+      }
+      out += ' ';
+    }
+    out += random.pick(kThaiWords);
+  }
+  out += '\n';
+}
+
+constexpr std::string_view kLogWords[] = {
+    "request", "served", "in", "ms", "bytes", "user", "id", "status",
+    "GET", "POST", "/api/v1/items", "ok", "retry", "cache", "hit", "miss",
+};
+
+// One line with no newline at all; the caller ends the corpus with one
+void appendLongLine(Random &random, std::string &out) {
+  if (random.chance(30)) {
+    random.digits(out, 1 + random.below(8));
+  } else {
+    out += random.pick(kLogWords);
+  }
+  out += random.chance(10) ? "=" : " ";
+}
+
+// Generates `size` bytes of `profile`, cut back to a character boundary.
+std::string generate(const std::string &profile, uint64_t seed, size_t size) {
+  Random random(seed);
+  std::string text;
+  text.reserve(size + 256);
+  bool first = true;
+  while (text.size() < size) {
+    if (profile == "prose") {
+      appendProse(random, text);
+    } else if (profile == "csv") {
+      appendCsv(random, text, first);
+    } else if (profile == "thai") {
+      appendThai(random, text);
+    } else {
+      appendLongLine(random, text);
+    }
+    first = false;
+  }
+  text.resize(size);
+  text.resize(size - incompleteUtf8Tail(text));
+  if (profile == "longline" && !text.empty())
+    text.back() = '\n';
+  return text;
+}
+
+bool writeFile(const std::string &path, std::string_view data) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  file.close();
+  return static_cast<bool>(file);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  CLI::App app{"Generate deterministic corpora for benchmarking zenkaku."};
+
+  std::string profile = "prose";
+  app.add_option("-p,--profile", profile,
+                 "Corpus profile: prose (Japanese, sparse digits), csv "
+                 "(numeric-heavy), thai (mixed native and ASCII digits), "
+                 "longline (one very long line).")
+      ->check(CLI::IsMember({"prose", "csv", "thai", "longline"}));
+
+  uint64_t seed = 1;
+  app.add_option("-s,--seed", seed, "Random seed.");
+
+  size_t size = 16 << 20;
+  app.add_option("-n,--size", size,
+                 "Bytes of forward input. Accepts K/M/G suffixes.")
+      ->transform(CLI::AsSizeValue(false));
+
+  std::string output_dir = ".";
+  app.add_option("-o,--output-dir", output_dir,
+                 "Directory to write the corpus files to.");
+
+  CLI11_PARSE(app, argc, argv);
+
+  // <profile>-<seed>.ascii.txt is the forward input; <profile>-<seed>.<type>.txt
+  // is the same text converted by <type>, i.e. the reverse input
+  std::string ascii = generate(profile, seed, size);
+  std::string stem = output_dir + "/" + profile + "-" + std::to_string(seed);
+  std::vector<std::pair<std::string, std::string>> files;
+  files.emplace_back(stem + ".ascii.txt", ascii);
+
+  const ConverterRegistry &registry = defaultRegistry();
+  for (const ConverterRegistry::Entry &entry : registry.getEntries()) {
+    std::string converted;
+    entry.converter->convert(ascii, converted);
+    files.emplace_back(stem + "." + std::string(entry.name) + ".txt",
+                       std::move(converted));
+  }
+
+  for (const auto &[path, data] : files) {
+    if (!writeFile(path, data)) {
+      std::cerr << "Error: cannot write '" << path << "'" << std::endl;
+      return 1;
+    }
+    std::cout << path << '\n';
+  }
+
+  return 0;
+}
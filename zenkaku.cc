@@ -1,316 +1,170 @@
-#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
-#include <locale>
-#include <map>
-#include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
-// Include the CLI11 single-header file
-#include <CLI/CLI.hpp>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-// --- Base Converter Interface ---
-class DigitConverter {
-public:
-  virtual ~DigitConverter() = default;
-  virtual void convert(const std::string &input, std::wostream &os) const = 0;
-  virtual void reverse(const std::string &input, std::ostream &os) const = 0;
-  virtual std::string getName() const = 0;
-  virtual bool usesWideOutput() const = 0;
-};
+#include <zenkaku/server.hpp>
+#include <zenkaku/stats.hpp>
+#include <zenkaku/stream.hpp>
+#include <zenkaku/uring.hpp>
+#include <zenkaku/zenkaku.hpp>
 
-// --- Full-Width Converter ---
-class FullWidthConverter : public DigitConverter {
-public:
-  void convert(const std::string &input, std::wostream &os) const override {
-    for (char ch : input) {
-      if (ch >= '0' && ch <= '9') {
-        wchar_t fullWidthDigit = static_cast<wchar_t>(L'\uFF10' + (ch - '0'));
-        os << fullWidthDigit;
-      } else {
-        os << static_cast<wchar_t>(ch);
-      }
-    }
-  }
+// Include the CLI11 single-header file
+#include <CLI/CLI.hpp>
 
-  void reverse(const std::string &input, std::ostream &os) const override {
-    for (size_t i = 0; i < input.length();) {
-      // Full-width digits U+FF10 to U+FF19 are encoded as 3 bytes in UTF-8
-      if (i + 2 < input.length() &&
-          static_cast<unsigned char>(input[i]) == 0xEF &&
-          static_cast<unsigned char>(input[i + 1]) == 0xBC &&
-          (static_cast<unsigned char>(input[i + 2]) >= 0x90 &&
-           static_cast<unsigned char>(input[i + 2]) <= 0x99)) {
-
-        char asciiDigit =
-            '0' + (static_cast<unsigned char>(input[i + 2]) - 0x90);
-        os << asciiDigit;
-        i += 3;
-      } else {
-        os << input[i];
-        i += 1;
-      }
+// The conversion engines live in libzenkaku; this file is only the command
+// line front end.
+using namespace zenkaku;
+
+namespace {
+
+// Converts `inFd` into `outFd` through a running `--serve` daemon, one
+// request per block of input. Blocks end on a UTF-8 boundary, so every
+// request holds whole characters. Returns false on failure, with the
+// daemon's message in `error` if it refused a request and errno set
+// otherwise.
+bool convertRemote(ConversionClient &client, const DigitConverter &converter,
+                   const std::string &type, RequestDirection direction,
+                   int inFd, int outFd, std::string &error) {
+  std::vector<char> buffer(StreamConverter::kBlockSize + 4);
+  ConversionClient::Response response;
+  size_t carry = 0;
+  bool eof = false;
+  while (!eof) {
+    ssize_t n;
+    {
+      PhaseTimer timer(Phase::Read);
+      n = ::read(inFd, buffer.data() + carry, StreamConverter::kBlockSize);
     }
-  }
-
-  std::string getName() const override { return "fullwidth"; }
-  bool usesWideOutput() const override { return true; }
-};
-
-// --- Circle-Enclosed Converter ---
-class CircleConverter : public DigitConverter {
-public:
-  void convert(const std::string &input, std::wostream &os) const override {
-    for (char ch : input) {
-      if (ch >= '0' && ch <= '9') {
-        wchar_t circleDigit;
-        if (ch == '0') {
-          circleDigit = L'\u24EA'; // ⓪
-        } else {
-          circleDigit = static_cast<wchar_t>(L'\u2460' + (ch - '1')); // ①-⑨
-        }
-        os << circleDigit;
-      } else {
-        os << static_cast<wchar_t>(ch);
-      }
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
     }
-  }
-
-  void reverse(const std::string &input, std::ostream &os) const override {
-    for (size_t i = 0; i < input.length(); ++i) {
-      // Circled Digits 1-9: U+2460 to U+2468
-      if (i + 2 < input.length() &&
-          static_cast<unsigned char>(input[i]) == 0xE2 &&
-          static_cast<unsigned char>(input[i + 1]) == 0x91 &&
-          (static_cast<unsigned char>(input[i + 2]) >= 0xA0 &&
-           static_cast<unsigned char>(input[i + 2]) <= 0xA8)) {
-
-        char asciiDigit = '1' + (input[i + 2] - 0xA0);
-        os << asciiDigit;
-        i += 2;
-      }
-      // Circled Digit Zero: U+24EA
-      else if (i + 2 < input.length() &&
-               static_cast<unsigned char>(input[i]) == 0xE2 &&
-               static_cast<unsigned char>(input[i + 1]) == 0x92 &&
-               static_cast<unsigned char>(input[i + 2]) == 0xAA) {
-
-        os << '0';
-        i += 2;
-      } else {
-        os << input[i];
-      }
+    std::string_view block(buffer.data(), carry + static_cast<size_t>(n));
+    // A truncated sequence at end of input is passed through unchanged
+    eof = n == 0;
+    carry = eof ? 0 : incompleteUtf8Tail(block);
+    block.remove_suffix(carry);
+    if (block.empty())
+      continue;
+    {
+      // The round trip is this process's conversion time
+      PhaseTimer timer(Phase::Convert);
+      if (!client.request(type, direction, block, response))
+        return false;
     }
-  }
-
-  std::string getName() const override { return "circle"; }
-  bool usesWideOutput() const override { return true; }
-};
-
-// --- Roman Numeral Converter ---
-class RomanConverter : public DigitConverter {
-private:
-  const std::vector<std::wstring> romanNumerals = {
-      L"０", L"Ⅰ", L"Ⅱ", L"Ⅲ", L"Ⅳ", L"Ⅴ", L"Ⅵ", L"Ⅶ", L"Ⅷ", L"Ⅸ"};
-
-public:
-  void convert(const std::string &input, std::wostream &os) const override {
-    for (char ch : input) {
-      if (ch >= '0' && ch <= '9') {
-        os << romanNumerals[ch - '0'];
-      } else {
-        os << static_cast<wchar_t>(ch);
-      }
+    if (response.status != ResponseStatus::Ok) {
+      error = std::move(response.body);
+      return false;
     }
+    recordConversion(converter, direction == RequestDirection::Reverse, block,
+                     response.body.size());
+    PhaseTimer timer(Phase::Write);
+    if (!writeAll(outFd, response.body))
+      return false;
+    std::memmove(buffer.data(), block.data() + block.size(), carry);
   }
+  return true;
+}
 
-  void reverse(const std::string &input, std::ostream &os) const override {
-    // Note: This is a simplified reverse implementation
-    // A full implementation would need to handle UTF-8 decoding properly
-    for (size_t i = 0; i < input.length();) {
-      bool found = false;
-
-      // Check for Roman numerals (simplified approach)
-      if (i + 2 < input.length()) {
-        // Check for specific UTF-8 sequences of Roman numerals
-        // This is simplified - in practice, you'd want a more robust UTF-8
-        // decoder
-
-        // Full-width 0 (０): U+FF10
-        if (static_cast<unsigned char>(input[i]) == 0xEF &&
-            static_cast<unsigned char>(input[i + 1]) == 0xBC &&
-            static_cast<unsigned char>(input[i + 2]) == 0x90) {
-          os << '0';
-          i += 3;
-          found = true;
-        }
-        // Roman I (Ⅰ): U+2160
-        else if (static_cast<unsigned char>(input[i]) == 0xE2 &&
-                 static_cast<unsigned char>(input[i + 1]) == 0x85 &&
-                 static_cast<unsigned char>(input[i + 2]) == 0xA0) {
-          os << '1';
-          i += 3;
-          found = true;
-        }
-        // Add more Roman numeral reversals as needed...
-      }
+void stopServer(int) { ConversionServer::stop(); }
 
-      if (!found) {
-        os << input[i];
-        i += 1;
-      }
-    }
+// Prints the --stats summary to stderr in one write.
+void printStats(std::chrono::steady_clock::time_point start) {
+  Stats stats = collectStats();
+  auto seconds = [](auto duration) {
+    return std::chrono::duration<double>(duration).count();
+  };
+  double elapsed = seconds(std::chrono::steady_clock::now() - start);
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+
+  std::ostringstream report;
+  report << "stats:\n"
+         << "  bytes in    " << stats.bytesIn << '\n'
+         << "  bytes out   " << stats.bytesOut << '\n'
+         << "  lines       " << stats.lines << '\n'
+         << "  sequences   " << stats.sequences;
+  for (const auto &[name, count] : stats.sequencesByConverter) {
+    report << ' ' << name << '=' << count;
   }
+  report << std::fixed << std::setprecision(3) << '\n'
+         << "  read        " << seconds(stats.readTime) << " s\n"
+         << "  convert     " << seconds(stats.convertTime) << " s\n"
+         << "  write       " << seconds(stats.writeTime) << " s\n"
+         << "  elapsed     " << elapsed << " s\n"
+         << "  throughput  " << std::setprecision(1)
+         << (elapsed > 0 ? static_cast<double>(stats.bytesIn) / elapsed / 1e6
+                         : 0.0)
+         << " MB/s\n"
+         << "  peak rss    " << usage.ru_maxrss << " KiB\n";
+  std::cerr << report.str() << std::flush;
+}
 
-  std::string getName() const override { return "roman"; }
-  bool usesWideOutput() const override { return true; }
-};
-
-// --- Chinese Numeral Converter ---
-class ChineseConverter : public DigitConverter {
-private:
-  const std::vector<std::wstring> chineseNumerals = {
-      L"〇", L"一", L"二", L"三", L"四", L"五", L"六", L"七", L"八", L"九"};
-
+// Enables statistics, prints them on every SIGUSR1 and once more when
+// destroyed. SIGUSR1 is blocked in the constructing thread, and so in every
+// thread started after it, and taken with sigwait() on a thread of its own,
+// so nothing is printed from a signal handler.
+class StatsReporter {
 public:
-  void convert(const std::string &input, std::wostream &os) const override {
-    for (char ch : input) {
-      if (ch >= '0' && ch <= '9') {
-        os << chineseNumerals[ch - '0'];
-      } else {
-        os << static_cast<wchar_t>(ch);
+  StatsReporter() : start(std::chrono::steady_clock::now()) {
+    sigset_t signals;
+    ::sigemptyset(&signals);
+    ::sigaddset(&signals, SIGUSR1);
+    ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    enableStats();
+    thread = std::thread([this, signals] {
+      int signal;
+      while (::sigwait(&signals, &signal) == 0 && !finished.load()) {
+        printStats(start);
       }
-    }
+    });
   }
 
-  void reverse(const std::string &input, std::ostream &os) const override {
-    // Simplified reverse implementation
-    // In practice, you'd implement proper UTF-8 decoding for Chinese characters
-    for (size_t i = 0; i < input.length();) {
-      bool found = false;
-
-      if (i + 2 < input.length()) {
-        // Check for specific Chinese numeral UTF-8 sequences
-        // 〇 (U+3007): E3 80 87
-        if (static_cast<unsigned char>(input[i]) == 0xE3 &&
-            static_cast<unsigned char>(input[i + 1]) == 0x80 &&
-            static_cast<unsigned char>(input[i + 2]) == 0x87) {
-          os << '0';
-          i += 3;
-          found = true;
-        }
-        // 一 (U+4E00): E4 B8 80
-        else if (static_cast<unsigned char>(input[i]) == 0xE4 &&
-                 static_cast<unsigned char>(input[i + 1]) == 0xB8 &&
-                 static_cast<unsigned char>(input[i + 2]) == 0x80) {
-          os << '1';
-          i += 3;
-          found = true;
-        }
-        // Add more Chinese numeral reversals as needed...
-      }
+  StatsReporter(const StatsReporter &) = delete;
+  StatsReporter &operator=(const StatsReporter &) = delete;
 
-      if (!found) {
-        os << input[i];
-        i += 1;
-      }
-    }
+  ~StatsReporter() {
+    finished.store(true);
+    ::pthread_kill(thread.native_handle(), SIGUSR1);
+    thread.join();
+    printStats(start);
   }
 
-  std::string getName() const override { return "chinese"; }
-  bool usesWideOutput() const override { return true; }
-};
-
-// --- Thai Numeral Converter ---
-class ThaiConverter : public DigitConverter {
 private:
-  const std::vector<std::wstring> thaiNumerals = {L"๐", L"๑", L"๒", L"๓", L"๔",
-                                                  L"๕", L"๖", L"๗", L"๘", L"๙"};
-
-public:
-  void convert(const std::string &input, std::wostream &os) const override {
-    for (char ch : input) {
-      if (ch >= '0' && ch <= '9') {
-        os << thaiNumerals[ch - '0'];
-      } else {
-        os << static_cast<wchar_t>(ch);
-      }
-    }
-  }
-
-  void reverse(const std::string &input, std::ostream &os) const override {
-    for (size_t i = 0; i < input.length();) {
-      bool found = false;
-
-      if (i + 2 < input.length()) {
-        // Thai digits U+0E50 to U+0E59
-        if (static_cast<unsigned char>(input[i]) == 0xE0 &&
-            static_cast<unsigned char>(input[i + 1]) == 0xB9 &&
-            (static_cast<unsigned char>(input[i + 2]) >= 0x90 &&
-             static_cast<unsigned char>(input[i + 2]) <= 0x99)) {
-
-          char asciiDigit =
-              '0' + (static_cast<unsigned char>(input[i + 2]) - 0x90);
-          os << asciiDigit;
-          i += 3;
-          found = true;
-        }
-      }
-
-      if (!found) {
-        os << input[i];
-        i += 1;
-      }
-    }
-  }
-
-  std::string getName() const override { return "thai"; }
-  bool usesWideOutput() const override { return true; }
+  std::chrono::steady_clock::time_point start;
+  std::atomic<bool> finished{false};
+  std::thread thread;
 };
 
-// --- Converter Registry ---
-class ConverterRegistry {
-private:
-  std::map<std::string, std::unique_ptr<DigitConverter>> converters;
-
-public:
-  ConverterRegistry() {
-    // Register all available converters
-    registerConverter(std::make_unique<FullWidthConverter>());
-    registerConverter(std::make_unique<CircleConverter>());
-    registerConverter(std::make_unique<RomanConverter>());
-    registerConverter(std::make_unique<ChineseConverter>());
-    registerConverter(std::make_unique<ThaiConverter>());
-  }
-
-  void registerConverter(std::unique_ptr<DigitConverter> converter) {
-    std::string name = converter->getName();
-    converters[name] = std::move(converter);
-  }
-
-  const DigitConverter *getConverter(const std::string &name) const {
-    auto it = converters.find(name);
-    return (it != converters.end()) ? it->second.get() : nullptr;
-  }
-
-  std::vector<std::string> getAvailableTypes() const {
-    std::vector<std::string> types;
-    for (const auto &pair : converters) {
-      types.push_back(pair.first);
-    }
-    return types;
-  }
-};
+} // namespace
 
 int main(int argc, char **argv) {
   // Setup converter registry
-  ConverterRegistry registry;
+  const ConverterRegistry &registry = defaultRegistry();
 
   // CLI11 Setup
   CLI::App app{"Convert digits in text to various Unicode formats or reverse."};
 
   std::string conversion_type = "fullwidth";
-  auto available_types = registry.getAvailableTypes();
+  std::vector<std::string> available_types(
+      registry.getAvailableTypes().begin(), registry.getAvailableTypes().end());
+  // "any" folds every registered script at once; reverse only
+  available_types.push_back("any");
   std::string type_list = "Available types: ";
   for (size_t i = 0; i < available_types.size(); ++i) {
     if (i > 0)
@@ -327,6 +181,82 @@ int main(int argc, char **argv) {
                "Reverse conversion from Unicode digits back to ASCII.")
       ->group("Conversion Options");
 
+  size_t jobs = 1;
+  CLI::Option *jobs_option =
+      app.add_option("-j,--jobs", jobs,
+                     "Convert on N worker threads. A file given with -i and "
+                     "-o is sized and converted straight into the mapped "
+                     "output; any other input is streamed in chunks. "
+                     "Output order is kept.")
+          ->check(CLI::PositiveNumber)
+          ->group("Processing Options");
+
+  bool pipeline_option = false;
+  CLI::Option *pipeline_flag =
+      app.add_flag("--pipeline", pipeline_option,
+                   "Read, convert and write on three threads at once, so "
+                   "pipe I/O overlaps with conversion.")
+          ->excludes(jobs_option)
+          ->group("Processing Options");
+
+  bool uring_option = false;
+  app.add_flag("--io-uring", uring_option,
+               "Keep several reads and writes in flight on an io_uring while "
+               "converting. Falls back to blocking I/O where io_uring is "
+               "unavailable.")
+      ->excludes(jobs_option)
+      ->excludes(pipeline_flag)
+      ->group("Processing Options");
+
+  std::string input_path;
+  app.add_option("-i,--input", input_path,
+                 "Read input from FILE via mmap instead of stdin.")
+      ->check(CLI::ExistingFile)
+      ->group("Processing Options");
+
+  std::string output_path;
+  app.add_option("-o,--output", output_path,
+                 "Write output to FILE instead of stdout. With --jobs and a "
+                 "regular file on stdin, workers write straight into the "
+                 "memory-mapped output.")
+      ->group("Processing Options");
+
+  std::vector<std::string> kernel_names;
+  for (Kernel kernel : kKernels) {
+    kernel_names.emplace_back(kernelName(kernel));
+  }
+  std::string kernel_name;
+  app.add_option("--kernel", kernel_name,
+                 "Force a conversion kernel instead of the best one this CPU "
+                 "supports.")
+      ->check(CLI::IsMember(kernel_names))
+      ->group("Processing Options");
+
+  bool print_kernel = false;
+  app.add_flag("--print-kernel", print_kernel,
+               "Print the selected and supported kernels, then exit.")
+      ->group("Processing Options");
+
+  bool stats_option = false;
+  app.add_flag("--stats", stats_option,
+               "Print byte, line and sequence counts, phase timings, "
+               "throughput and peak RSS to stderr at exit and on SIGUSR1.")
+      ->group("Processing Options");
+
+  std::string serve_path;
+  CLI::Option *serve_option =
+      app.add_option("--serve", serve_path,
+                     "Stay resident and answer framed conversion requests on "
+                     "the Unix domain socket SOCKET until SIGINT or SIGTERM.")
+          ->group("Server Options");
+
+  std::string connect_path;
+  app.add_option("--connect", connect_path,
+                 "Convert through the daemon listening on SOCKET instead of "
+                 "in this process.")
+      ->excludes(serve_option)
+      ->group("Server Options");
+
   std::vector<std::string> input_args;
   app.add_option("text", input_args,
                  "Text arguments to convert. If empty, reads from stdin.")
@@ -335,54 +265,188 @@ int main(int argc, char **argv) {
 
   CLI11_PARSE(app, argc, argv);
 
+  if (!kernel_name.empty() && !selectKernel(*parseKernel(kernel_name))) {
+    std::cerr << "Error: Kernel '" << kernel_name
+              << "' is not supported on this CPU" << std::endl;
+    return 1;
+  }
+  if (print_kernel) {
+    std::cout << "kernel: " << kernelName(activeKernel()) << "\nsupported:";
+    for (Kernel kernel : kKernels) {
+      if (kernelSupported(kernel))
+        std::cout << ' ' << kernelName(kernel);
+    }
+    std::cout << std::endl;
+    return 0;
+  }
+
+  // Before any worker thread exists, so they all inherit the signal mask
+  std::optional<StatsReporter> reporter;
+  if (stats_option)
+    reporter.emplace();
+
+  if (!serve_path.empty()) {
+    // No SA_RESTART, so a blocked epoll_wait() sees the signal
+    struct sigaction action {};
+    action.sa_handler = stopServer;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    ConversionServer server;
+    if (!server.listen(serve_path) || !server.run()) {
+      std::cerr << "Error: " << std::strerror(errno) << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
   // Get the selected converter
-  const DigitConverter *converter = registry.getConverter(conversion_type);
+  if (conversion_type == "any" && !reverse_option) {
+    std::cerr << "Error: Conversion type 'any' requires --reverse"
+              << std::endl;
+    return 1;
+  }
+  const DigitConverter *converter = findConverter(conversion_type);
   if (!converter) {
     std::cerr << "Error: Unknown conversion type '" << conversion_type << "'"
               << std::endl;
     return 1;
   }
 
-  // Locale Setup
-  std::locale::global(std::locale("en_US.utf8"));
+  if (!input_path.empty() && !input_args.empty()) {
+    std::cerr << "Error: --input cannot be combined with text arguments"
+              << std::endl;
+    return 1;
+  }
 
-  // Set up output stream based on conversion mode
-  if (!reverse_option && converter->usesWideOutput()) {
-    std::wcout.imbue(std::locale("en_US.utf8"));
+  int inFd = STDIN_FILENO;
+  if (!input_path.empty()) {
+    inFd = ::open(input_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (inFd < 0) {
+      std::cerr << "Error: cannot open '" << input_path
+                << "': " << std::strerror(errno) << std::endl;
+      return 1;
+    }
   }
 
-  // Process Input
-  auto processText = [&](const std::string &text) {
-    if (reverse_option) {
-      converter->reverse(text, std::cout);
-      std::cout << '\n';
-    } else {
-      if (converter->usesWideOutput()) {
-        converter->convert(text, std::wcout);
-        std::wcout << L'\n';
-      } else {
-        // For future converters that might use narrow output
-        std::stringstream ss;
-        std::wstringstream wss;
-        converter->convert(text, wss);
-        // Convert wide to narrow (simplified)
-        std::wcout << wss.str() << L'\n';
+  int outFd = STDOUT_FILENO;
+  if (!output_path.empty()) {
+    // Read access too, since the mapped writer needs a shared mapping.
+    // Truncated only once it is known not to be the input.
+    outFd = ::open(output_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (outFd < 0) {
+      std::cerr << "Error: cannot open '" << output_path
+                << "': " << std::strerror(errno) << std::endl;
+      return 1;
+    }
+    // Devices and FIFOs have nothing to truncate
+    struct stat outInfo;
+    if (::fstat(outFd, &outInfo) == 0 && S_ISREG(outInfo.st_mode)) {
+      struct stat inInfo;
+      if (::fstat(inFd, &inInfo) == 0 && inInfo.st_dev == outInfo.st_dev &&
+          inInfo.st_ino == outInfo.st_ino) {
+        std::cerr << "Error: '" << output_path << "' is also the input"
+                  << std::endl;
+        return 1;
+      }
+      if (::ftruncate(outFd, 0) != 0) {
+        std::cerr << "Error: cannot truncate '" << output_path
+                  << "': " << std::strerror(errno) << std::endl;
+        return 1;
       }
     }
-  };
+  }
 
-  if (input_args.empty()) {
-    // Read from stdin
-    std::string line;
-    while (std::getline(std::cin, line)) {
-      processText(line);
+  ConversionClient client;
+  if (!connect_path.empty() && !client.connect(connect_path)) {
+    std::cerr << "Error: cannot connect to '" << connect_path
+              << "': " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  RequestDirection direction =
+      reverse_option ? RequestDirection::Reverse : RequestDirection::Forward;
+
+  bool ok = true;
+  std::string remote_error;
+  if (!connect_path.empty() && input_args.empty()) {
+    // Send the input to the daemon block by block
+    ok = convertRemote(client, *converter, conversion_type, direction, inFd,
+                       outFd, remote_error);
+  } else if (input_args.empty()) {
+    struct stat inInfo, outInfo;
+    bool regularInput =
+        ::fstat(inFd, &inInfo) == 0 && S_ISREG(inInfo.st_mode);
+    bool fileToFile = regularInput && !output_path.empty() &&
+                      ::fstat(outFd, &outInfo) == 0 && S_ISREG(outInfo.st_mode);
+    if (jobs > 1 && fileToFile) {
+      // Size every chunk, then convert in parallel into the mapped output
+      MappedParallelConverter mapped(*converter, reverse_option, jobs);
+      ok = mapped.run(inFd, outFd);
+    } else if (jobs > 1) {
+      // Convert newline-aligned chunks of the input in parallel
+      ParallelStreamConverter stream(*converter, reverse_option, jobs);
+      ok = stream.run(inFd, outFd);
+    } else if (uring_option && UringConverter::supported()) {
+      // Queue reads and writes on the kernel while converting
+      UringConverter uring(*converter, reverse_option);
+      ok = uring.run(inFd, outFd);
+    } else if (pipeline_option) {
+      // Overlap reading, converting and writing block by block
+      PipelineConverter pipeline(*converter, reverse_option);
+      ok = pipeline.run(inFd, outFd);
+    } else if (!input_path.empty() && regularInput) {
+      // Write unchanged runs straight from the mapped input
+      MappedFileConverter mapped(*converter, reverse_option);
+      ok = mapped.run(inFd, outFd);
+    } else {
+      // Stream the input through in fixed-size blocks
+      StreamConverter stream(*converter, reverse_option);
+      ok = stream.run(inFd, outFd);
     }
   } else {
-    // Process direct arguments
+    // Process direct arguments, one output line each
+    std::string out;
+    ConversionClient::Response response;
     for (const std::string &arg : input_args) {
-      processText(arg);
+      out.clear();
+      bool converted = true;
+      {
+        PhaseTimer timer(Phase::Convert);
+        if (connect_path.empty()) {
+          convertText(*converter, reverse_option, arg, out);
+        } else if (client.request(conversion_type, direction, arg,
+                                  response) &&
+                   response.status == ResponseStatus::Ok) {
+          out = std::move(response.body);
+        } else {
+          converted = false;
+        }
+      }
+      if (!converted) {
+        if (response.status != ResponseStatus::Ok)
+          remote_error = std::move(response.body);
+        ok = false;
+        break;
+      }
+      recordConversion(*converter, reverse_option, arg, out.size());
+      out.push_back('\n');
+      PhaseTimer timer(Phase::Write);
+      if (!(ok = writeAll(outFd, out)))
+        break;
     }
   }
 
+  if (!ok) {
+    // A request the daemon refused is reported in its words, once
+    std::cerr << "Error: "
+              << (remote_error.empty() ? std::strerror(errno) : remote_error)
+              << std::endl;
+    return 1;
+  }
+  if (outFd != STDOUT_FILENO && ::close(outFd) != 0) {
+    std::cerr << "Error: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
   return 0;
 }